@@ -0,0 +1,412 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// main.cpp    (V. Drozd)
+// src/bin/testFileInfoLogger/src/main.cpp
+//
+
+//
+// Regression tests of FileInfoLogger module, exit code is the number of
+// the failed tests
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define BOOST_FILESYSTEM_VERSION 3
+#define BOOST_FILESYSTEM_NO_DEPRECATED
+
+#include "CalculateSum/FileFilterSpec.h"
+#include "CalculateSum/FileInfoLogger.h"
+#include "CalculateSum/Fingerprint.h"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: type declarations
+//
+
+typedef bool (*test_fn)(const fs::path& tempDir);
+
+struct TestCase {
+    const char *name;
+    test_fn     run;
+};
+
+//Pattern, path relative to the root and the expected result of the filter
+struct GlobCase {
+    const char *pattern;
+    bool        is_exclude;
+    const char *rel_path;
+    bool        is_dir;       //isDirIncluded() is tested instead of isNameIncluded()
+    bool        is_included;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declarations
+//
+
+//
+// File of the stalled read (FIFO without writer) is logged as timed out
+// and process() returns, the hung worker is abandoned
+//
+
+static bool _t_test_stalled_fifo(const fs::path& tempDir);
+
+//
+// Include and exclude globs of FileFilterSpec (see _s_globCases)
+//
+
+static bool _t_test_glob_rules(const fs::path& tempDir);
+
+//
+// Fingerprint parameters that overflow the sampled size (given by -F or read
+// from the label of the manifest) are rejected, the file isn't read by them
+//
+
+static bool _t_test_fingerprint_overflow(const fs::path& tempDir);
+
+//
+// Lines of the text file, empty if it can't be read
+//
+
+static std::vector<std::string> _t_read_lines(const fs::path& filePath);
+
+//
+// Print the failed check in stderr, always false
+//
+
+static bool _t_check_failed(const char *test, const std::string& reason);
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: variable definitions
+//
+
+static const TestCase _s_tests[] = {
+    { "stalled_fifo", _t_test_stalled_fifo },
+    { "glob_rules",   _t_test_glob_rules },
+    { "fingerprint_overflow", _t_test_fingerprint_overflow },
+};
+
+static const GlobCase _s_globCases[] = {
+    //"**/" matches zero or more directories
+    { "src/**/*.cpp",  false, "src/a.cpp",       false, true  },
+    { "src/**/*.cpp",  false, "src/x/y/a.cpp",   false, true  },
+    { "src/**/*.cpp",  false, "srca.cpp",        false, false },
+    { "src/**/*.cpp",  false, "a.cpp",           false, false },
+    { "**/*.h",        false, "a.h",             false, true  },
+    { "**/*.h",        false, "x/y/a.h",         false, true  },
+    { "**/tmp/**",     true,  "tmp/a",           false, false },
+    { "**/tmp/**",     true,  "x/tmp/y/a",       false, false },
+    { "**/tmp/**",     true,  "x/tmpa/a",        false, true  },
+
+    //'*' and '?' stay within one component
+    { "src/*.cpp",     false, "src/x/a.cpp",     false, false },
+    { "a?c",           false, "abc",             false, true  },
+    { "x/a?c",         false, "x/a/c",           false, false },
+
+    //Classes and negated classes
+    { "[a-c]x",        false, "bx",              false, true  },
+    { "[a-c]x",        false, "dx",              false, false },
+    { "[!a-z]*.txt",   false, "A.txt",           false, true  },
+    { "[!a-z]*.txt",   false, "1.txt",           false, true  },
+    { "[!a-z]*.txt",   false, "a.txt",           false, false },
+    { "x/a[!b]c",      false, "x/a/c",           false, false },
+    { "[]]",           false, "]",               false, true  },
+
+    //Not closed '[' is the literal character
+    { "a[b",           false, "a[b",             false, true  },
+    { "a[b",           false, "ab",              false, false },
+    { "[abc",          false, "[abc",            false, true  },
+    { "*[",            false, "x[",              false, true  },
+
+    //"build/" excludes directories only, "build" both files and directories
+    { "build/",        true,  "build",           true,  false },
+    { "build/",        true,  "src/build",       true,  false },
+    { "build/",        true,  "build",           false, true  },
+    { "build/",        true,  "src/build",       false, true  },
+    { "build",         true,  "build",           false, false },
+    { "build",         true,  "src/build",       true,  false },
+    { "/src/out/",     true,  "src/out",         true,  false },
+    { "/src/out/",     true,  "x/src/out",       true,  true  },
+
+    //"*.ext" is looked up in the set, it must match as the glob does
+    { "*.txt",         false, "a.txt",           false, true  },
+    { "*.txt",         false, ".txt",            false, true  },
+    { "*.txt",         false, "a.txt.bak",       false, false },
+    { "*.txt",         false, "txt",             false, false },
+    { "*.gz",          false, "a.tar.gz",        false, true  },
+    { "*.tar.gz",      false, "a.tar.gz",        false, true  },
+    { "*.tar.gz",      false, "a.gz",            false, false },
+    { "*.bashrc",      false, ".bashrc",         false, true  },
+    { "*.bashrc",      false, "x/.bashrc",       false, true  },
+    { "*.bashrc",      false, "bashrc",          false, false },
+    { ".bashrc",       false, ".bashrc",         false, true  },
+    { ".bashrc",       false, "x.bashrc",        false, false },
+    { "*.bash[r]c",    false, ".bashrc",         false, true  },
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: definitions
+//
+
+int main()
+{
+    int failed = 0;
+
+    for (size_t i = 0; i < sizeof(_s_tests) / sizeof(_s_tests[0]); i++) {
+        boost::system::error_code ec;
+        fs::path tempDir = fs::temp_directory_path(ec) / fs::unique_path("testFileInfoLogger-%%%%-%%%%-%%%%");
+
+        if (ec || !fs::create_directories(tempDir, ec)) {
+            std::cerr << "Can't create the temporary directory " << tempDir.string() << std::endl;
+            return (EXIT_FAILURE);
+            //NOTREACHED
+        }
+
+        bool status = _s_tests[i].run(tempDir);
+        std::cout << (status ? "PASS " : "FAIL ") << _s_tests[i].name << std::endl;
+
+        if (!status)
+            failed++;
+
+        fs::remove_all(tempDir, ec);
+    }
+
+    return (failed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local definitions
+//
+
+static bool _t_test_stalled_fifo(const fs::path& tempDir)
+{
+    static const char testName[] = "stalled_fifo";
+
+#ifdef _WIN32
+    //No FIFO in the file system, the named pipes are outside of it
+    (void)tempDir;
+    return true;
+#else
+    std::vector<fs::path> filePaths;
+    filePaths.push_back(tempDir / "a.txt");
+    filePaths.push_back(tempDir / "pipe");
+
+    fs::path logPath = tempDir / "file_inf.log";
+
+    std::ofstream(filePaths[0].string().c_str(), std::ios::binary) << "hello\n";
+
+    if (mkfifo(filePaths[1].c_str(), 0600)) {
+        return _t_check_failed(testName, "can't create the FIFO");
+        //NOTREACHED
+    }
+
+    {
+        FileInfoLogger fileLogger(filePaths, logPath);
+        fileLogger.setStallTimeout(1);
+
+        //Hung process() can't be joined, the test is failed without waiting for it
+        std::shared_ptr<std::promise<bool>> done = std::make_shared<std::promise<bool>>();
+        std::future<bool> result = done->get_future();
+
+        std::thread([&fileLogger, done]() { done->set_value(fileLogger.process()); }).detach();
+
+        if (result.wait_for(std::chrono::seconds(30)) != std::future_status::ready) {
+            _t_check_failed(testName, "process() doesn't return after the stall timeout");
+            std::_Exit(EXIT_FAILURE);
+            //NOTREACHED
+        }
+
+        if (!result.get()) {
+            return _t_check_failed(testName, "process() failed");
+            //NOTREACHED
+        }
+    }
+
+    std::vector<std::string> lines = _t_read_lines(logPath);
+
+    if (lines.size() != 2) {
+        return _t_check_failed(testName, "log must have 2 records");
+        //NOTREACHED
+    }
+
+    //Creation time is the current one, so only the rest of the record is compared
+    const std::string digest(", MD5: b1946ac92492d2347c6235b4d2611184");
+    if (lines[0].find("a.txt, size is: 6 bytes, created: ") != 0 || lines[0].size() < digest.size() ||
+        lines[0].compare(lines[0].size() - digest.size(), digest.size(), digest)) {
+        return _t_check_failed(testName, "unexpected record: " + lines[0]);
+        //NOTREACHED
+    }
+
+    if (lines[1].find("pipe, error: " + std::to_string(ETIMEDOUT) + " ") != 0) {
+        return _t_check_failed(testName, "unexpected record: " + lines[1]);
+        //NOTREACHED
+    }
+
+    //Abandoned worker comes back when the logger is gone, it must not touch it
+    int fd = open(filePaths[1].c_str(), O_WRONLY | O_NONBLOCK);
+    if (fd >= 0)
+        close(fd);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    return true;
+#endif
+}
+
+static bool _t_test_glob_rules(const fs::path& tempDir)
+{
+    static const char testName[] = "glob_rules";
+
+    (void)tempDir;
+    bool retVal = true;
+
+    for (size_t i = 0; i < sizeof(_s_globCases) / sizeof(_s_globCases[0]); i++) {
+        const GlobCase& test = _s_globCases[i];
+
+        FileFilterSpec filterSpec;
+        if (test.is_exclude)
+            filterSpec.addExclude(test.pattern);
+        else
+            filterSpec.addInclude(test.pattern);
+
+        //Depth of the directory is the number of its components
+        const std::string relPath(test.rel_path);
+        const size_t depth = std::count(relPath.begin(), relPath.end(), '/') + 1;
+
+        bool isIncluded = test.is_dir ? filterSpec.isDirIncluded(relPath, depth)
+                                      : filterSpec.isNameIncluded(relPath);
+
+        if (isIncluded != test.is_included) {
+            retVal = _t_check_failed(testName, std::string(test.is_exclude ? "exclude " : "include ") +
+                                     test.pattern + (test.is_dir ? ", directory " : ", file ") + relPath +
+                                     (test.is_included ? " must be included" : " must not be included"));
+        }
+    }
+
+    return (retVal);
+}
+
+static bool _t_test_fingerprint_overflow(const fs::path& tempDir)
+{
+    static const char testName[] = "fingerprint_overflow";
+
+    //"-F 18446744073709551615x1" on the 64-bit system
+    FingerprintSpec spec;
+    spec.sample_count = std::numeric_limits<size_t>::max();
+    spec.sample_size  = 1024;
+    spec.head_size    = spec.sample_size;
+    spec.tail_size    = spec.sample_size;
+
+    if (spec.isValid()) {
+        return _t_check_failed(testName, "sample count " + std::to_string(spec.sample_count) + " must be rejected");
+        //NOTREACHED
+    }
+
+    static const char *badLabels[] = {
+        "FINGERPRINT[h1024,t1024,18446744073709551615x1024]",
+        "FINGERPRINT[h1024,t1024,4097x1024]",
+        "FINGERPRINT[h9223372036854775807,t1,1x1]",
+        "FINGERPRINT[h1024,t1024,4096x4503599627370496]",
+        "FINGERPRINT[h1024,t1024,16x0]",
+    };
+
+    for (size_t i = 0; i < sizeof(badLabels) / sizeof(badLabels[0]); i++) {
+        FingerprintSpec labelSpec;
+        if (labelSpec.fromLabel(badLabels[i])) {
+            return _t_check_failed(testName, std::string("label ") + badLabels[i] + " must be rejected");
+            //NOTREACHED
+        }
+    }
+
+    FingerprintSpec goodSpec;
+    goodSpec.sample_count = FingerprintSpec::MAX_SAMPLE_COUNT;
+    if (!goodSpec.isValid() || !spec.fromLabel(goodSpec.label()) || spec.label() != goodSpec.label()) {
+        return _t_check_failed(testName, "label " + goodSpec.label() + " must be restored");
+        //NOTREACHED
+    }
+
+    //Spec that isn't checked by the caller fails the file instead of the division by zero
+    std::vector<fs::path> filePaths;
+    filePaths.push_back(tempDir / "a.txt");
+    fs::path logPath = tempDir / "file_inf.log";
+
+    std::ofstream(filePaths[0].string().c_str(), std::ios::binary) << std::string(8192, 'a');
+
+    spec.sample_count = std::numeric_limits<size_t>::max();
+    spec.sample_size  = 1;
+    spec.head_size    = spec.sample_size;
+    spec.tail_size    = spec.sample_size;
+
+    {
+        FileInfoLogger fileLogger(filePaths, logPath);
+        fileLogger.setFingerprint(&spec);
+
+        if (!fileLogger.process() || fileLogger.failedCount() != 1) {
+            return _t_check_failed(testName, "file must be logged as failed");
+            //NOTREACHED
+        }
+    }
+
+    std::vector<std::string> lines = _t_read_lines(logPath);
+
+    if (lines.size() != 1 || lines[0].find("a.txt, error: " + std::to_string(EINVAL) + " ") != 0) {
+        return _t_check_failed(testName, "unexpected log: " + (lines.empty() ? std::string() : lines[0]));
+        //NOTREACHED
+    }
+
+    return true;
+}
+
+static std::vector<std::string> _t_read_lines(const fs::path& filePath)
+{
+    std::vector<std::string> retVal;
+    std::ifstream file(filePath.string().c_str(), std::ios::binary);
+
+    std::string line;
+    while (std::getline(file, line))
+        retVal.push_back(line);
+
+    return (retVal);
+}
+
+static bool _t_check_failed(const char *test, const std::string& reason)
+{
+    std::cerr << test << ": " << reason << std::endl;
+    return false;
+}
+
+//
+//
+//
@@ -26,13 +26,42 @@
 #define BOOST_FILESYSTEM_VERSION 3
 #define BOOST_FILESYSTEM_NO_DEPRECATED
 
+#include "CalculateSum/BinaryManifest.h"
+#include "CalculateSum/BlockHashList.h"
+#include "CalculateSum/ChunkList.h"
+#include "CalculateSum/DirectoryWalker.h"
+#include "CalculateSum/DuplicateFinder.h"
+#include "CalculateSum/FileFilterSpec.h"
+#include "CalculateSum/FileInfoDaemon.h"
+#include "CalculateSum/FileInfoDiff.h"
 #include "CalculateSum/FileInfoLogger.h"
+#include "CalculateSum/FileInfoMerger.h"
+#include "CalculateSum/FileInfoSink.h"
+#include "CalculateSum/FileInfoVerifier.h"
+#include "CalculateSum/Fingerprint.h"
+#include "CalculateSum/FileInfoWatcher.h"
+#include "CalculateSum/KnownHashSet.h"
+#include "CalculateSum/MerkleManifest.h"
 
 #include <boost/filesystem.hpp>
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <vector>
 
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <signal.h>
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 // %% BeginSection: variable definitions
 //
@@ -40,15 +69,46 @@
 #define LOG_FILE_NAME "file_inf.log"
 static const char *_s_logFileName = LOG_FILE_NAME;
 
+//Daemon stopped by Ctrl+C, NULL when it isn't running (or is stopping already)
+static FileInfoDaemon * volatile _s_runningDaemon = NULL;
+
 ///////////////////////////////////////////////////////////////////////////////
 // %% BeginSection: declarations
 //
 
 //
-// return the full filenames of all files in the specified directory
+// Decimal number of the option, false if it is empty, has a sign, is out of
+// the range of the type or is followed by anything (if end isn't requested)
+//
+
+template <typename T>
+static bool _t_parse_number(const char *text, T& value, char **end = NULL);
+
+//
+// Size in bytes with the optional K, M or G suffix
+//
+
+static bool _t_parse_size(const char *text, unsigned long long& size, char **end);
+
+//
+// Name of the partial log of the shard index of count
+//
+
+static std::string _t_shard_log_name(unsigned int index, unsigned int count);
+
+//
+// Print the estimate of deduplication in stdout
+//
+
+static void _t_print_dedup(const ChunkList::DedupStats& stats);
+
+//
+// Stop the daemon by Ctrl+C or termination (SIGINT and SIGTERM, console
+// control events on Windows), so it closes the clients and removes the socket.
+// The next Ctrl+C kills the process as usual
 //
 
-void getAllFileNames(const fs::path& root_path, std::vector<fs::path>& fileNames);
+static void _t_set_stop_handler(FileInfoDaemon& daemon);
 
 //
 // Print usage message in stdout
@@ -74,39 +134,590 @@ static void _t_unknwn_error_occured();
 
 int main(int argc, char *argv[])
 {
-    if (argc != 2) {
+    const char *workDirArg = NULL;
+    const char *socketArg = NULL;
+    const char *manifestArg = NULL;
+    const char *knownTableArg = NULL;
+    const char *knownListArg = NULL;
+    const char *merkleArg = NULL;
+    const char *oldMerkleArg = NULL;
+    const char *newMerkleArg = NULL;
+    const char *oldLogArg = NULL;
+    const char *newLogArg = NULL;
+    const char *binaryArg = NULL;
+    const char *printBinaryArg = NULL;
+    const char *queryArg = NULL;
+    const char *outputArg = NULL;
+    const char *blockListArg = NULL;
+    const char *chunkListArg = NULL;
+    size_t maxFailures = static_cast<size_t>(-1);
+    unsigned int stallTimeout = 0;
+    unsigned int fileDeadline = 0;
+    bool incremental = false;
+    bool recursive = false;
+    bool watch = false;
+    bool checkpoint = false;
+    bool duplicates = false;
+    bool failFast = false;
+    bool unordered = false;
+    bool chunking = false;
+    bool fingerprint = false;
+    FingerprintSpec fingerprintSpec;
+    FileFilterSpec filterSpec;
+    unsigned long long minSize = 0;
+    unsigned long long maxSize = static_cast<unsigned long long>(-1);
+    unsigned int newerDays = 0;
+    unsigned int olderDays = 0;
+    unsigned int shardIndex = 0;
+    unsigned int shardCount = 0;
+    unsigned int mergeCount = 0;
+    int compressLevel = 0;
+    size_t blockSize = 0;
+
+    for (int i = 1; i < argc; i++) {
+        bool isNumberValid = true;
+
+        //Help message
+        if (!std::strcmp(argv[i], "-h")) {
+            _t_usage();
+            return 0;
+            //NOTREACHED
+        }
+
+        if (!std::strcmp(argv[i], "-i")) {
+            incremental = true;
+        }
+        else if (!std::strcmp(argv[i], "-r")) {
+            recursive = true;
+        }
+        else if (!std::strcmp(argv[i], "-c")) {
+            checkpoint = true;
+        }
+        else if (!std::strcmp(argv[i], "-e") && i + 1 < argc) {
+            isNumberValid = _t_parse_number(argv[++i], maxFailures);
+        }
+        else if (!std::strcmp(argv[i], "-t") && i + 1 < argc) {
+            isNumberValid = _t_parse_number(argv[++i], stallTimeout);
+        }
+        else if (!std::strcmp(argv[i], "-T") && i + 1 < argc) {
+            isNumberValid = _t_parse_number(argv[++i], fileDeadline);
+        }
+        else if (!std::strcmp(argv[i], "-k") && i + 1 < argc) {
+            knownTableArg = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "-b") && i + 2 < argc) {
+            knownListArg = argv[++i];
+            knownTableArg = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "-M") && i + 1 < argc) {
+            merkleArg = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "-C") && i + 2 < argc) {
+            oldMerkleArg = argv[++i];
+            newMerkleArg = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "-x") && i + 2 < argc) {
+            oldLogArg = argv[++i];
+            newLogArg = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "-s") && i + 1 < argc) {
+            char *end = NULL;
+            isNumberValid = _t_parse_number(argv[++i], shardIndex, &end) && '/' == *end &&
+                            _t_parse_number(end + 1, shardCount) && shardIndex < shardCount;
+        }
+        else if (!std::strcmp(argv[i], "-j") && i + 1 < argc) {
+            isNumberValid = _t_parse_number(argv[++i], mergeCount);
+        }
+        else if (!std::strcmp(argv[i], "-B") && i + 1 < argc) {
+            binaryArg = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "-P") && i + 1 < argc) {
+            printBinaryArg = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "-q") && i + 2 < argc) {
+            printBinaryArg = argv[++i];
+            queryArg = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "-o") && i + 1 < argc) {
+            outputArg = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "-z") && i + 1 < argc) {
+            isNumberValid = _t_parse_number(argv[++i], compressLevel) &&
+                            compressLevel >= 1 && compressLevel <= 9;
+        }
+        else if (!std::strcmp(argv[i], "-L") && i + 1 < argc) {
+            isNumberValid = _t_parse_number(argv[++i], blockSize) &&
+                            blockSize && blockSize <= std::numeric_limits<size_t>::max() / (1024 * 1024);
+            blockSize *= 1024 * 1024;
+        }
+        else if (!std::strcmp(argv[i], "-V") && i + 1 < argc) {
+            blockListArg = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "-K")) {
+            chunking = true;
+        }
+        else if (!std::strcmp(argv[i], "-A") && i + 1 < argc) {
+            chunkListArg = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "-F") && i + 1 < argc) {
+            char *end = NULL;
+            size_t sampleKiB = 0;
+            isNumberValid = _t_parse_number(argv[++i], fingerprintSpec.sample_count, &end) && 'x' == *end &&
+                            _t_parse_number(end + 1, sampleKiB) &&
+                            sampleKiB && sampleKiB <= std::numeric_limits<size_t>::max() / 1024;
+
+            fingerprintSpec.sample_size = sampleKiB * 1024;
+            fingerprintSpec.head_size = fingerprintSpec.sample_size;
+            fingerprintSpec.tail_size = fingerprintSpec.sample_size;
+            fingerprint = true;
+
+            isNumberValid = isNumberValid && fingerprintSpec.isValid();
+        }
+        else if (!std::strcmp(argv[i], "-I") && i + 1 < argc) {
+            filterSpec.addInclude(argv[++i]);
+        }
+        else if (!std::strcmp(argv[i], "-E") && i + 1 < argc) {
+            filterSpec.addExclude(argv[++i]);
+        }
+        else if (!std::strcmp(argv[i], "-S") && i + 1 < argc) {
+            char *end = NULL;
+            isNumberValid = _t_parse_size(argv[++i], minSize, &end);
+            if (isNumberValid && '-' == *end)
+                isNumberValid = _t_parse_size(end + 1, maxSize, &end);
+
+            isNumberValid = isNumberValid && !*end;
+        }
+        else if (!std::strcmp(argv[i], "-N") && i + 1 < argc) {
+            isNumberValid = _t_parse_number(argv[++i], newerDays);
+        }
+        else if (!std::strcmp(argv[i], "-O") && i + 1 < argc) {
+            isNumberValid = _t_parse_number(argv[++i], olderDays);
+        }
+        else if (!std::strcmp(argv[i], "-l") && i + 1 < argc) {
+            size_t depth = 0;
+            isNumberValid = _t_parse_number(argv[++i], depth);
+            filterSpec.setMaxDepth(depth);
+        }
+        else if (!std::strcmp(argv[i], "-X")) {
+            filterSpec.setOneFileSystem(true);
+        }
+        else if (!std::strcmp(argv[i], "-u")) {
+            unordered = true;
+        }
+        else if (!std::strcmp(argv[i], "-D")) {
+            duplicates = true;
+        }
+        else if (!std::strcmp(argv[i], "-v") && i + 1 < argc) {
+            manifestArg = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "-f")) {
+            failFast = true;
+        }
+        else if (!std::strcmp(argv[i], "-m")) {
+            watch = true;
+        }
+        else if (!std::strcmp(argv[i], "-d") && i + 1 < argc) {
+            socketArg = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "-w") && i + 1 < argc && !workDirArg) {
+            workDirArg = argv[++i];
+        }
+        else if (argv[i][0] != '-' && !workDirArg) {
+            workDirArg = argv[i];
+        }
+        else {
+            _t_args_error_occured();
+            return 0;
+            //NOTREACHED
+        }
+
+        //Malformed value must not turn into 0 (e.g. "-e abc" aborting at the first failure)
+        if (!isNumberValid) {
+            _t_args_error_occured();
+            return 0;
+            //NOTREACHED
+        }
+    }
+
+    //Binary manifest is made from the text log only
+    if (outputArg && binaryArg) {
         _t_args_error_occured();
         return 0;
         //NOTREACHED
     }
 
-    //Help message
-    if (!std::strcmp(argv[1], "-h")) {
-        _t_usage();
+    //Table of known hashes is made once and used by many runs
+    if (knownListArg) {
+        if (!KnownHashSet::build(knownListArg, knownTableArg)) {
+            std::cerr << "Can't make " << knownTableArg << " from " << knownListArg << std::endl;
+            return (EXIT_FAILURE);
+            //NOTREACHED
+        }
+
+        std::cout << "Table of known hashes saved to " << knownTableArg << " file" << std::endl;
+        return 0;
+    }
+
+    //Comparison of two trees reads only their manifests
+    if (oldMerkleArg) {
+        size_t differences = 0;
+
+        if (!MerkleManifest::compare(oldMerkleArg, newMerkleArg, std::cout, differences)) {
+            std::cerr << "Can't compare " << oldMerkleArg << " and " << newMerkleArg << std::endl;
+            return (EXIT_FAILURE);
+            //NOTREACHED
+        }
+
+        std::cout << differences << " difference(s) found" << std::endl;
+        return differences ? (EXIT_FAILURE) : 0;
+    }
+
+    //Logs are merged line by line, so they can be of any size
+    if (oldLogArg) {
+        FileInfoDiff diff(oldLogArg, newLogArg);
+
+        if (!diff.process(std::cout)) {
+            std::cerr << "Can't compare " << oldLogArg << " and " << newLogArg
+                      << " (the logs must be made by testSample)" << std::endl;
+            return (EXIT_FAILURE);
+            //NOTREACHED
+        }
+
+        std::cout << diff.addedCount() << " added, "
+                  << diff.removedCount() << " removed, "
+                  << diff.modifiedCount() << " modified, "
+                  << diff.unchangedCount() << " unchanged file(s)" << std::endl;
+
+        bool isSame = !diff.addedCount() && !diff.removedCount() && !diff.modifiedCount();
+        return isSame ? 0 : (EXIT_FAILURE);
+    }
+
+    //Chunks of the several runs can be analyzed together if they are concatenated
+    if (chunkListArg) {
+        ChunkList::DedupStats stats;
+
+        if (!ChunkList::analyze(chunkListArg, stats)) {
+            std::cerr << "Can't read chunks " << chunkListArg << std::endl;
+            return (EXIT_FAILURE);
+            //NOTREACHED
+        }
+
+        _t_print_dedup(stats);
+        return 0;
+    }
+
+    //Binary manifest is searched or printed without parsing
+    if (printBinaryArg) {
+        BinaryManifest manifest;
+
+        if (!manifest.open(printBinaryArg)) {
+            std::cerr << "Can't open binary manifest " << printBinaryArg << std::endl;
+            return (EXIT_FAILURE);
+            //NOTREACHED
+        }
+
+        if (!queryArg) {
+            return manifest.writeText(std::cout) ? 0 : (EXIT_FAILURE);
+            //NOTREACHED
+        }
+
+        //The name is tried first, then the digest
+        std::vector<FileInfo> found;
+        FileInfo finfo;
+
+        if (manifest.findByName(queryArg, finfo))
+            found.push_back(finfo);
+        else
+            found = manifest.findByDigest(queryArg);
+
+        for (size_t i = 0; i < found.size(); i++)
+            std::cout << found[i].toString();
+
+        return found.empty() ? (EXIT_FAILURE) : 0;
+    }
+
+    //Daemon mode doesn't need working directory
+    if (socketArg) {
+        FileInfoDaemon daemon(socketArg);
+        _t_set_stop_handler(daemon);
+        std::cout << "Listening on " << socketArg << ", press Ctrl+C to stop" << std::endl;
+
+        if (!daemon.run()) {
+            std::cerr << "Can't listen on " << socketArg
+                      << " (the path must be free or taken by the socket)" << std::endl;
+            return (EXIT_FAILURE);
+            //NOTREACHED
+        }
+        return 0;
+    }
+
+    //Files are checked in the directory of the manifest by default
+    std::string manifestDir;
+    if ((manifestArg || blockListArg) && !workDirArg) {
+        manifestDir = fs::absolute(manifestArg ? manifestArg : blockListArg).parent_path().string();
+        workDirArg = manifestDir.c_str();
+    }
+
+    if (!workDirArg) {
+        _t_args_error_occured();
         return 0;
         //NOTREACHED
     }
 
-    const fs::path workDir(argv[1]);
+    const fs::path workDir(workDirArg);
+
+    //Verification mode doesn't write anything, only reports problems
+    if (manifestArg) {
+        FileInfoVerifier verifier(manifestArg, workDir);
+        verifier.setFailFast(failFast);
+
+        if (!verifier.process(std::cout)) {
+            std::cerr << "Can't read manifest " << manifestArg << std::endl;
+            return (EXIT_FAILURE);
+            //NOTREACHED
+        }
+
+        std::cout << verifier.matchedCount() << " file(s) matched, "
+                  << verifier.mismatchedCount() << " mismatched, "
+                  << verifier.missingCount() << " missing, "
+                  << verifier.failedCount() << " can't be read" << std::endl;
+
+        return verifier.isIntact() ? 0 : (EXIT_FAILURE);
+    }
+
+    //Only the blocks of the large files are checked, damaged regions are reported
+    if (blockListArg) {
+        BlockHashList blockList;
+
+        if (!blockList.load(blockListArg)) {
+            std::cerr << "Can't read block digests " << blockListArg << std::endl;
+            return (EXIT_FAILURE);
+            //NOTREACHED
+        }
+
+        blockList.verify(workDir, std::cout);
+
+        std::cout << blockList.checkedCount() << " block(s) checked, "
+                  << blockList.damagedCount() << " damaged, "
+                  << blockList.failedCount() << " can't be read, "
+                  << blockList.missingCount() << " file(s) missing, "
+                  << blockList.resizedCount() << " resized" << std::endl;
+
+        return blockList.isIntact() ? 0 : (EXIT_FAILURE);
+    }
+
+    //Manifest of the whole tree instead of the log of the directory
+    if (merkleArg) {
+        MerkleManifest manifest(workDir);
+
+        if (!manifest.process() || !manifest.write(merkleArg)) {
+            _t_unknwn_error_occured();
+            return (EXIT_FAILURE);
+            //NOTREACHED
+        }
+
+        if (manifest.failedCount())
+            std::cerr << manifest.failedCount() << " file(s) or directories can't be read" << std::endl;
+
+        std::cout << "Tree digest " << manifest.rootDigest() << " saved to " << merkleArg << " file" << std::endl;
+        return 0;
+    }
+
+    //Partial logs of all shards are combined into the final one
+    if (mergeCount) {
+        std::vector<fs::path> partList;
+        for (unsigned int i = 0; i < mergeCount; i++)
+            partList.push_back(workDir / (_t_shard_log_name(i, mergeCount) + (compressLevel ? ".gz" : "")));
+
+        fs::path fullLogFileName = workDir / fs::path(_s_logFileName);
+        FileInfoMerger merger(partList, fullLogFileName);
+
+        if (!merger.process()) {
+            std::cerr << "Can't merge partial logs, all " << mergeCount
+                      << " shards must be finished" << std::endl;
+            return (EXIT_FAILURE);
+            //NOTREACHED
+        }
+
+        std::cout << merger.recordCount() << " record(s) saved to " << fullLogFileName.string() << " file" << std::endl;
+        return 0;
+    }
+
+    //Ranges are tested by the walker, so the files out of them are not even hashed
+    const std::time_t now = std::time(nullptr);
+    filterSpec.setSizeRange(minSize, maxSize);
+    filterSpec.setTimeRange(
+        newerDays ? now - static_cast<std::time_t>(newerDays) * 86400 : std::numeric_limits<std::time_t>::min(),
+        olderDays ? now - static_cast<std::time_t>(olderDays) * 86400 : std::numeric_limits<std::time_t>::max()
+    );
+
+    //Only the working directory itself is listed without -r
+    if (!recursive)
+        filterSpec.setMaxDepth(1);
+
+    //Monitor mode never returns on success
+    if (watch) {
+        fs::path fullLogFileName = workDir / fs::path(_s_logFileName);
+
+        FileInfoWatcher watcher(workDir, fullLogFileName);
+        watcher.setRecursive(recursive);
+        watcher.setFilterSpec(filterSpec);
+        std::cout << "Watching " << workDir.string() << ", press Ctrl+C to stop" << std::endl;
+
+        if (!watcher.run()) {
+            _t_unknwn_error_occured();
+            return (EXIT_FAILURE);
+            //NOTREACHED
+        }
+        return 0;
+    }
+
+    //Logs of the other shards (and the final log) are written in the same directory,
+    //and output of the previous run is not logged too
+    const fs::path outputPath(outputArg ? outputArg : "");
+    auto isLogged = [shardCount, &outputPath](const fs::path& thisPath) -> bool {
+        const fs::path name = thisPath.filename();
+
+        if (shardCount && !name.string().compare(0, sizeof(LOG_FILE_NAME) - 1, LOG_FILE_NAME)) {
+            return false;
+            //NOTREACHED
+        }
+
+        boost::system::error_code ec;
+        return (outputPath.empty() || name != outputPath.filename() || !fs::equivalent(thisPath, outputPath, ec));
+    };
+
+    //Tree is logged while it is walked, there is no list of files
+    DirectoryWalker walker(workDir);
+    walker.setFileFilter(isLogged);
+    walker.setFilterSpec(filterSpec);
 
     //Get all files names
     std::vector<fs::path> fileList;
-    getAllFileNames(workDir, fileList);
-    if (fileList.empty()) {
-        std::cout << "There are no files in " << argv[1] << " directory" << std::endl;
+    if (!recursive || duplicates) {
+        if (!walker.process() && recursive) {
+            std::cerr << "Can't read " << workDir.string() << " directory" << std::endl;
+            return (EXIT_FAILURE);
+            //NOTREACHED
+        }
+
+        fileList = walker.files();
+    }
+
+    if (!recursive && fileList.empty()) {
+        std::cout << "There are no files in " << workDirArg << " directory" << std::endl;
         return 0;
         //NOTREACHED
     }
     
-    fs::path fullLogFileName = fs::path(argv[1]) / fs::path(_s_logFileName);
+    //Duplicates are printed instead of the log
+    if (duplicates) {
+        DuplicateFinder finder(fileList);
+
+        if (!finder.process()) {
+            _t_unknwn_error_occured();
+            return (EXIT_FAILURE);
+            //NOTREACHED
+        }
+
+        finder.writeGroups(std::cout);
+        std::cout << finder.groups().size() << " group(s) of duplicates found, "
+                  << finder.bytesRead() << " bytes read" << std::endl;
+        return 0;
+    }
+
+    fs::path fullLogFileName = workDir / fs::path(_s_logFileName);
+    if (shardCount)
+        fullLogFileName = workDir / _t_shard_log_name(shardIndex, shardCount);
+    if (compressLevel)
+        fullLogFileName += ".gz";
+
+    std::unique_ptr<FileInfoLogger> logger(
+        recursive ? new FileInfoLogger(walker, fullLogFileName) : new FileInfoLogger(fileList, fullLogFileName)
+    );
+
+    FileInfoLogger& fileLogger = *logger;
+    fileLogger.setIncrementalUpdate(incremental);
+    fileLogger.setCheckpointing(checkpoint);
+    fileLogger.setFailureThreshold(maxFailures);
+    fileLogger.setStallTimeout(stallTimeout);
+    fileLogger.setFileDeadline(fileDeadline);
+    fileLogger.setCompression(compressLevel);
+    fileLogger.setBlockDigests(blockSize);
+    fileLogger.setContentChunking(chunking);
+    fileLogger.setFingerprint(fingerprint ? &fingerprintSpec : NULL);
+
+    if (shardCount)
+        fileLogger.setShard(shardIndex, shardCount);
+
+    KnownHashSet knownHashes;
+    if (knownTableArg) {
+        if (!knownHashes.open(knownTableArg)) {
+            std::cerr << "Can't open table of known hashes " << knownTableArg << std::endl;
+            return (EXIT_FAILURE);
+            //NOTREACHED
+        }
+
+        fileLogger.setKnownHashSet(&knownHashes);
+    }
+
+    //Format of the output is chosen by its extension
+    std::unique_ptr<FileInfoSink> sink;
+    if (outputArg) {
+        const std::string extension = fs::path(outputArg).extension().string();
+
+        if (extension == ".gz")
+            sink.reset(new GzipLogSink(outputArg, compressLevel ? compressLevel : 6));
+        else if (extension == ".jsonl" || extension == ".json")
+            sink.reset(new JsonLinesSink(outputArg));
+        else if (extension == ".csv")
+            sink.reset(new CsvSink(outputArg));
+        else
+            sink.reset(new TextLogSink(outputArg));
+
+        fullLogFileName = outputArg;
+    }
+
+    if (sink || unordered)
+        fileLogger.setSink(sink.get(), unordered);
 
-    FileInfoLogger fileLogger(fileList, fullLogFileName);
     if (!fileLogger.process()) {
+        if (fileLogger.failedCount())
+            std::cerr << "Too many files failed, the run was aborted" << std::endl;
+
         _t_unknwn_error_occured();
         return (EXIT_FAILURE);
         //NOTREACHED
     }
 
+    if (walker.failedCount())
+        std::cerr << walker.failedCount() << " subdirectory(ies) can't be read" << std::endl;
+
+    if (fileLogger.failedCount()) {
+        std::cerr << fileLogger.failedCount()
+                  << " file(s) can't be read, see error records in the log" << std::endl;
+    }
+
+    if (knownTableArg) {
+        std::cout << fileLogger.knownCount()
+                  << " file(s) found in the set of known hashes, marked as KNOWN in the log" << std::endl;
+    }
+
+    if (chunking) {
+        ChunkList::DedupStats stats;
+
+        //Chunks are saved next to the log, -o changes only where the records go
+        if (ChunkList::analyze(fileLogger.chunkListPath(), stats))
+            _t_print_dedup(stats);
+    }
+
+    //Binary form is made from the complete log
+    if (binaryArg && !BinaryManifestWriter::convert(fullLogFileName, binaryArg)) {
+        std::cerr << "Can't write binary manifest " << binaryArg << std::endl;
+        return (EXIT_FAILURE);
+        //NOTREACHED
+    }
+
 #ifdef _WIN32
 	setlocale(0, "");
 #else
@@ -122,22 +733,111 @@ int main(int argc, char *argv[])
 // %% BeginSection: local definitions
 //
 
-void getAllFileNames(const fs::path& root_path, std::vector<fs::path>& fileNames)
+template <typename T>
+static bool _t_parse_number(const char *text, T& value, char **end)
 {
-    if (!fs::exists(root_path) && !fs::is_directory(root_path)) {
-        return;
+    //strtoull() skips spaces and takes the sign, neither is a part of the number here
+    if (!std::isdigit(static_cast<unsigned char>(*text))) {
+        return false;
         //NOTREACHED
     }
 
-    fs::directory_iterator it(root_path);
-    fs::directory_iterator endit;
+    errno = 0;
+    char *stop = NULL;
+    unsigned long long number = std::strtoull(text, &stop, 10);
 
-    while (it != endit) {
-        if (fs::is_regular_file(*it)) {
-            fileNames.push_back(*it);
-        }
-        ++it;
+    if (ERANGE == errno || number > static_cast<unsigned long long>(std::numeric_limits<T>::max())) {
+        return false;
+        //NOTREACHED
+    }
+
+    if (end)
+        *end = stop;
+    else if (*stop)
+        return false;
+
+    value = static_cast<T>(number);
+    return true;
+}
+
+static bool _t_parse_size(const char *text, unsigned long long& size, char **end)
+{
+    if (!_t_parse_number(text, size, end)) {
+        return false;
+        //NOTREACHED
+    }
+
+    unsigned int shift = 0;
+
+    switch (**end) {
+    case 'K': case 'k': shift = 10; ++*end; break;
+    case 'M': case 'm': shift = 20; ++*end; break;
+    case 'G': case 'g': shift = 30; ++*end; break;
+    }
+
+    if (size > (std::numeric_limits<unsigned long long>::max() >> shift)) {
+        return false;
+        //NOTREACHED
     }
+
+    size <<= shift;
+    return true;
+}
+
+static std::string _t_shard_log_name(unsigned int index, unsigned int count)
+{
+    return std::string(_s_logFileName) + "." + std::to_string(index) + "-of-" + std::to_string(count);
+}
+
+static void _t_print_dedup(const ChunkList::DedupStats& stats)
+{
+    std::cout << stats.total_chunks << " chunk(s) of " << stats.total_bytes << " bytes, "
+              << stats.unique_chunks << " unique of " << stats.unique_bytes << " bytes, "
+              << "deduplication ratio " << stats.ratio() << std::endl;
+}
+
+#ifdef _WIN32
+static BOOL WINAPI _t_stop_handler(DWORD ctrlType)
+{
+    FileInfoDaemon *daemon = _s_runningDaemon;
+
+    //The other events (closing of the console) terminate the process anyway
+    if (!daemon || (CTRL_C_EVENT != ctrlType && CTRL_BREAK_EVENT != ctrlType)) {
+        return FALSE;
+        //NOTREACHED
+    }
+
+    _s_runningDaemon = NULL;
+    daemon->stop();
+
+    return TRUE;
+}
+#else
+static void _t_stop_handler(int)
+{
+    //Only the flag is set, so it is safe in the signal handler
+    if (_s_runningDaemon)
+        _s_runningDaemon->stop();
+}
+#endif
+
+static void _t_set_stop_handler(FileInfoDaemon& daemon)
+{
+    _s_runningDaemon = &daemon;
+
+#ifdef _WIN32
+    SetConsoleCtrlHandler(_t_stop_handler, TRUE);
+#else
+    //Handler is reset by the first signal, select() of the daemon is interrupted
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = _t_stop_handler;
+    action.sa_flags = SA_RESETHAND;
+    sigemptyset(&action.sa_mask);
+
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+#endif
 }
 
 static void _t_usage()
@@ -155,8 +855,143 @@ static void _t_usage()
          "\n"
          "-w <path>\tWorking directory [WDIR].\n"
          "\n"
+         "-i\t\tIncremental update: reuse records of the existing log\n"
+         "\t\tand calculate information only for new or changed files.\n"
+         "\n"
+         "-r\t\tLog files of the whole [WDIR] tree, names are relative to\n"
+         "\t\t[WDIR]. Directories are read by several threads and files\n"
+         "\t\tare hashed as soon as they are found.\n"
+         "\n"
+         "-c\t\tCheckpointing: journal calculated records, so the run\n"
+         "\t\tinterrupted by a crash skips them after restart.\n"
+         "\n"
+         "-e <count>\tAbort the run when more than <count> files can't be read\n"
+         "\t\t(by default all failed files are just logged with the reason).\n"
+         "\n"
+         "-t <seconds>\tLog the file as failed when its reading makes no progress\n"
+         "\t\tfor <seconds> (e.g. hung network share) and go on.\n"
+         "\n"
+         "-T <seconds>\tLog the file as failed when it can't be read in <seconds>.\n"
+         "\n"
+         "-k <path>\tMark files which MD5 is in the table of known hashes <path>\n"
+         "\t\tas KNOWN in the log.\n"
+         "\n"
+         "-b <list> <path>\n"
+         "\t\tMake the table of known hashes <path> from the text file\n"
+         "\t\t<list> (the first MD5 of every line is taken) and exit.\n"
+         "\n"
+         "-M <path>\tWrite the manifest of the whole [WDIR] tree to <path>,\n"
+         "\t\tevery directory has the digest of its children.\n"
+         "\n"
+         "-C <old> <new>\n"
+         "\t\tCompare two manifests made by -M, only subtrees with\n"
+         "\t\tdifferent digests are read.\n"
+         "\n"
+         "-x <old> <new>\n"
+         "\t\tPrint files added, removed and modified between two logs,\n"
+         "\t\tthe logs are merged line by line in constant memory.\n"
+         "\n"
+         "-s <i>/<n>\tLog only the shard <i> (from 0) of <n> shards of [WDIR]\n"
+         "\t\tto [WDIR]\\" LOG_FILE_NAME ".<i>-of-<n>, shards can be run by\n"
+         "\t\tseveral processes or hosts at once.\n"
+         "\n"
+         "-j <n>\t\tMerge partial logs of <n> shards to [WDIR]\\" LOG_FILE_NAME ".\n"
+         "\n"
+         "-B <path>\tAlso save the log as the compact binary manifest <path>.\n"
+         "\n"
+         "-P <path>\tPrint the binary manifest <path> as the text log.\n"
+         "\n"
+         "-q <path> <name|md5>\n"
+         "\t\tPrint records of the binary manifest <path> with this\n"
+         "\t\tfile name or digest (binary search, nothing is parsed).\n"
+         "\n"
+         "-o <path>\tWrite records to <path> instead of the log, the format is\n"
+         "\t\tchosen by the extension: .jsonl (JSON Lines), .csv, .gz (gzip\n"
+         "\t\tcompressed log) or text.\n"
+         "\n"
+         "-z <level>\tCompress the log by gzip with <level> from 1 to 9 and save\n"
+         "\t\tit to [WDIR]\\" LOG_FILE_NAME ".gz, compressed logs are read by\n"
+         "\t\t-i, -v, -x, -j and -B as well.\n"
+         "\n"
+         "-L <MiB>\tAlso record digests of every <MiB> block of the larger files\n"
+         "\t\tto [WDIR]\\" LOG_FILE_NAME ".blocks.\n"
+         "\n"
+         "-V <path>\tVerify blocks listed in <path> (made by -L) in parallel and\n"
+         "\t\tprint damaged regions of the files.\n"
+         "\n"
+         "-K\t\tAlso split files into content defined chunks (FastCDC, 8 KB\n"
+         "\t\ton average), save them to [WDIR]\\" LOG_FILE_NAME ".chunks and\n"
+         "\t\tprint the estimate of deduplication.\n"
+         "\n"
+         "-A <path>\tPrint the estimate of deduplication of the chunks <path>.\n"
+         "\n"
+         "-F <n>x<KiB>\tLog the sampled fingerprint instead of MD5: the size, head,\n"
+         "\t\ttail and <n> (up to 4096) evenly spaced samples of <KiB> are\n"
+         "\t\thashed, so large files are checked quickly but not every change\n"
+         "\t\tis found.\n"
+         "\n"
+         "-I <glob>\tLog only the files matched by <glob> (can be repeated), glob\n"
+         "\t\twithout '/' is matched against the name (*.jpg), with '/'\n"
+         "\t\tagainst the path relative to [WDIR] (docs/**/*.txt).\n"
+         "\n"
+         "-E <glob>\tDon't log files and don't read directories matched by <glob>\n"
+         "\t\t(can be repeated, e.g. -E .git -E '*.o' -E build/).\n"
+         "\n"
+         "-S <min>[-<max>]\n"
+         "\t\tLog only the files of this size in bytes, K, M and G\n"
+         "\t\tsuffixes are allowed (e.g. -S 4K or -S 1M-1G).\n"
+         "\n"
+         "-N <days>\tLog only the files modified during the last <days>.\n"
+         "\n"
+         "-O <days>\tLog only the files not modified during the last <days>.\n"
+         "\n"
+         "-l <levels>\tRead no more than <levels> levels of the tree by -r\n"
+         "\t\t(1 - [WDIR] only).\n"
+         "\n"
+         "-X\t\tDon't read directories of the other file systems by -r.\n"
+         "\n"
+         "-u\t\tWrite records as soon as they are calculated instead of\n"
+         "\t\tthe alphabetical order (such log can't be compared by -x).\n"
+         "\n"
+         "-D\t\tPrint groups of duplicate files instead of the log, files\n"
+         "\t\tare compared by size, head and tail, and only then by MD5.\n"
+         "\n"
+         "-v <path>\tVerify files of [WDIR] (directory of the manifest by default)\n"
+         "\t\tagainst the known-good log <path>, mismatched, missing and\n"
+         "\t\tunreadable files are reported as soon as they are found.\n"
+         "\n"
+         "-f\t\tStop verification at the first problem.\n"
+         "\n"
+         "-m\t\tMonitor mode: keep [WDIR]\\" LOG_FILE_NAME " current by watching\n"
+         "\t\tthe directory and recalculating only changed files, the\n"
+         "\t\twhole tree is watched by -r, -I, -E, -S, -N, -O and -l apply.\n"
+         "\n"
+         "-d <socket>\tDaemon mode: answer HASH/VERIFY requests received over\n"
+         "\t\tthe local socket, see FileInfoDaemon.h for the protocol.\n"
+         "\n"
          "EXAMPLES:\n"
-         " testSample -w ./home"
+         " testSample -w ./home\n"
+         " testSample -i -w ./home\n"
+         " testSample -r -i -w ./projects\n"
+         " testSample -r -X -E .git -E build/ -S 1K -w ./projects\n"
+         " testSample -m -w ./home\n"
+         " testSample -b ./malware.md5 ./malware.tbl\n"
+         " testSample -k ./malware.tbl -w ./home\n"
+         " testSample -M ./today.mft -w ./home\n"
+         " testSample -C ./yesterday.mft ./today.mft\n"
+         " testSample -s 0/2 -w ./home & testSample -s 1/2 -w ./home\n"
+         " testSample -j 2 -w ./home\n"
+         " testSample -B ./home.bmf -w ./home\n"
+         " testSample -q ./home.bmf photo.jpg\n"
+         " testSample -u -o ./home.jsonl -w ./home\n"
+         " testSample -i -z 6 -w ./home\n"
+         " testSample -L 4 -w ./images\n"
+         " testSample -K -w ./backups\n"
+         " testSample -i -F 16x64 -w ./videos\n"
+         " testSample -V ./images/" LOG_FILE_NAME ".blocks\n"
+         " testSample -x ./yesterday.log ./home/" LOG_FILE_NAME "\n"
+         " testSample -f -v ./home/" LOG_FILE_NAME "\n"
+         " testSample -d /tmp/calcsum.sock"
          "\n"
          "\n"
          "The testSample utility exits 0 on success, and >0 if an error occurs."
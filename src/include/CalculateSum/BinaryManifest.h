@@ -0,0 +1,152 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// BinaryManifest.h	(V. Drozd)
+// src/CalculateSum/BinaryManifest.h
+//
+
+//
+// Compact binary form of the log, which is memory mapped and searched
+// by name or by digest without parsing
+//
+
+//
+// The file consists of the header and the sections, every one is 8 bytes aligned:
+//
+//   digests      16 byte binary MD5 per record (zeros for the failed file)
+//   sizes        8 byte size per record
+//   names        8 byte offset of the name in the string table per record
+//   reasons      8 byte offset of the error reason (or of the digest type
+//                of the fingerprint) in the string table per record
+//   dates        4 byte creation date per record, packed as yyyymmdd
+//   errors       4 byte error code per record
+//   flags        4 byte flags per record (correct, known, fingerprint)
+//   name index   4 byte record numbers sorted by name (byte order)
+//   digest index 4 byte record numbers sorted by digest (MD5 only)
+//   strings      zero terminated names and reasons
+//
+// Records are in the order of the log, so the text log is reproduced as is.
+// Numbers are stored in the native byte order.
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include "CalculateSum/Types.h"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <ostream>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declarations
+//
+
+//
+// Collects records and writes the manifest when they are all added
+//
+
+class BinaryManifestWriter {
+public:
+    BinaryManifestWriter(const fs::path& manifestPath);
+
+    //Records must be added in the order of the log
+    void add(const FileInfo& finfo);
+
+    bool close();
+
+    //Convert the existing text log
+    static bool convert(const fs::path& logPath, const fs::path& manifestPath);
+private:
+    //deprecate copy constructor and assigment operator
+    BinaryManifestWriter(const BinaryManifestWriter&);
+    BinaryManifestWriter& operator=(const BinaryManifestWriter&);
+
+    size_t addString(const std::string& text);
+
+
+    fs::path                        manifest_path;
+
+    //Columns @{
+    std::vector<unsigned char>      digests;
+    std::vector<long long>          sizes;
+    std::vector<unsigned long long> names;
+    std::vector<unsigned long long> reasons;
+    std::vector<unsigned int>       dates;
+    std::vector<int>                errors;
+    std::vector<unsigned int>       flags;
+    std::string                     strings;
+    //@}
+};
+
+//
+// Memory mapped manifest
+//
+
+class BinaryManifest {
+public:
+    BinaryManifest();
+    ~BinaryManifest();
+
+    bool open(const fs::path& manifestPath);
+
+    //Number of records
+    size_t size() const;
+
+    //Record of the log by its number
+    FileInfo record(size_t idx) const;
+
+    //Binary search by the name, false if there is no such file
+    bool findByName(const std::string& name, FileInfo& finfo) const;
+
+    //Binary search by the digest, all files with this content
+    std::vector<FileInfo> findByDigest(const std::string& checksum) const;
+
+    //Reproduce the text log
+    bool writeText(std::ostream& out) const;
+private:
+    //deprecate copy constructor and assigment operator
+    BinaryManifest(const BinaryManifest&);
+    BinaryManifest& operator=(const BinaryManifest&);
+
+    //Mapped view of the manifest file
+    struct Mapping;
+
+    const char *nameOf(size_t idx) const;
+
+
+    std::unique_ptr<Mapping> mapping;
+
+    //Pointers into the mapped manifest @{
+    size_t                     record_count;
+    const unsigned char       *digests;
+    const long long           *sizes;
+    const unsigned long long  *names;
+    const unsigned long long  *reasons;
+    const unsigned int        *dates;
+    const int                 *errors;
+    const unsigned int        *flags;
+    const unsigned int        *name_index;
+    const unsigned int        *digest_index;
+    size_t                     digest_index_count;
+    const char                *strings;
+    unsigned long long         strings_size;
+    //@}
+};
+
+//
+//
+//
@@ -0,0 +1,96 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// BlockHashList.h	(V. Drozd)
+// src/CalculateSum/BlockHashList.h
+//
+
+//
+// Digests of the fixed size blocks of the large files, the sidecar of the log
+// (file_inf.log.blocks), so the damaged regions of the file can be found
+//
+
+//
+// Only files of more than one block are listed, one line per file:
+//
+//   <block size> <file size> <md5 of block 0> ... <md5 of the last block> <name>
+//
+// The last block is shorter if the file size isn't a multiple of the block size.
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include "CalculateSum/Types.h"
+
+#include <vector>
+#include <string>
+#include <ostream>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declarations
+//
+
+class BlockHashList {
+public:
+    struct Entry {
+        std::string              name;
+        long long                size;
+        size_t                   block_size;
+        std::vector<std::string> digests;
+    };
+
+    BlockHashList();
+
+    //Plain or gzip compressed list
+    bool load(const fs::path& listPath);
+
+    const std::vector<Entry>& entries() const;
+
+    //Line of the list without '\n' and back
+    static std::string format(const Entry& entry);
+    static bool parse(const std::string& line, Entry& entry);
+
+    //Rehash blocks of the listed files of workDir in parallel, problems are
+    //reported in the order of the list:
+    //  DAMAGED <name> <offset> <length>
+    //  UNREADABLE <name> <offset> <length>
+    //  RESIZED <name>
+    //  MISSING <name>
+    void verify(const fs::path& workDir, std::ostream& report);
+
+    //Counters of the last verify() @{
+    size_t checkedCount() const;
+    size_t damagedCount() const;
+    size_t failedCount() const;
+    size_t missingCount() const;
+    size_t resizedCount() const;
+    //@}
+
+    //No damaged, unreadable or missing blocks and no resized files were found
+    bool isIntact() const;
+private:
+    std::vector<Entry>     entry_list;
+
+    size_t                 checked_count;
+    size_t                 damaged_count;
+    size_t                 failed_count;
+    size_t                 missing_count;
+    size_t                 resized_count;
+};
+
+//
+//
+//
@@ -0,0 +1,79 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// ChunkList.h	(V. Drozd)
+// src/CalculateSum/ChunkList.h
+//
+
+//
+// Content defined chunks of the files, the sidecar of the log
+// (file_inf.log.chunks), to estimate how much data is duplicated in the tree
+//
+
+//
+// Files are split where the rolling hash of the content matches the mask
+// (FastCDC), so the same data gives the same chunks even if it is shifted.
+// Chunks are from 2 to 64 KB, 8 KB on average. One line per file:
+//
+//   <file size> <md5 of chunk>:<length> ... <name>
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include "CalculateSum/Types.h"
+
+#include <vector>
+#include <string>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declarations
+//
+
+class ChunkList {
+public:
+    struct Chunk {
+        std::string digest;
+        size_t      length;
+    };
+
+    struct Entry {
+        std::string        name;
+        long long          size;
+        std::vector<Chunk> chunks;
+    };
+
+    //Totals over all listed files
+    struct DedupStats {
+        unsigned long long total_bytes;
+        unsigned long long unique_bytes;
+        unsigned long long total_chunks;
+        unsigned long long unique_chunks;
+
+        //Total size to the size of the unique chunks (1.0 - nothing is duplicated)
+        double ratio() const;
+    };
+
+    //Line of the list without '\n' and back
+    static std::string format(const Entry& entry);
+    static bool parse(const std::string& line, Entry& entry);
+
+    //Read the list (plain or gzip compressed) and count the unique chunks
+    static bool analyze(const fs::path& listPath, DedupStats& stats);
+};
+
+//
+//
+//
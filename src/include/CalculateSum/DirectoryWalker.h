@@ -0,0 +1,176 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// DirectoryWalker.h	(V. Drozd)
+// src/CalculateSum/DirectoryWalker.h
+//
+
+//
+// Lists regular files of the whole directory tree by several threads at once:
+// every directory is the task of the pool, its subdirectories are queued as
+// new tasks, so idle workers take unexplored subtrees while the busy ones are
+// still reading their directories
+//
+
+//
+// Files are returned in the sorted order of their paths (the order of the log),
+// directory by directory in depth-first order. The caller may take them as
+// soon as they are found by start() and next(), the directory that is needed
+// next and isn't read yet is read by the caller itself, so the order never
+// waits for the queue. process() just collects all of them.
+//
+// Symbolic links to files are listed (as the one level listing does), but
+// directory links are not followed, so the tree can't loop.
+//
+// Directories rejected by FileFilterSpec are not read at all, files are tested
+// as they are listed.
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include "CalculateSum/Types.h"
+#include "CalculateSum/FileFilterSpec.h"
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declarations
+//
+
+class ThreadPool;
+
+class DirectoryWalker {
+public:
+    //Files for which it returns false are not listed
+    typedef std::function<bool(const fs::path&)> FileFilter;
+
+    DirectoryWalker(const fs::path& rootDir);
+    ~DirectoryWalker();
+
+    const fs::path& rootDir() const;
+
+    //Number of threads reading directories (0 - by the number of cores),
+    //directory reading waits for metadata, so more threads than cores may help
+    void setThreadCount(size_t count);
+
+    //Filter is called by the reading threads, so it must be thread safe
+    void setFileFilter(const FileFilter& filter);
+
+    //Files and directories of the tree that are listed (all by default)
+    void setFilterSpec(const FileFilterSpec& spec);
+
+    //Metadata of every file is taken by the reading threads (one statx per file)
+    //and returned along with the path, so the caller doesn't stat it again.
+    //It is taken anyway if the filter has size or time ranges
+    void setFileStats(bool enable);
+
+    //List all files of the tree, false if the root isn't a readable directory
+    bool process();
+
+    //Files found by the last process()
+    const std::vector<fs::path>& files() const;
+
+    //Start reading the tree in the background, false if the root can't be read
+    bool start();
+
+    //Next files in the sorted order, false at the end of the tree;
+    //without wait only the files that are already found are returned (maybe none)
+    bool next(std::vector<fs::path>& files, bool wait = true);
+
+    //The same with the metadata of the files (not valid if it isn't taken)
+    bool next(std::vector<fs::path>& files, std::vector<FileStat>& stats, bool wait = true);
+
+    //Number of subdirectories that can't be read
+    size_t failedCount() const;
+
+    //Files and subdirectories (if subdirs is set) of one directory, the types are
+    //taken from the directory entries (d_type by getdents64() on Linux, attributes
+    //of FindFirstFileEx() on Windows), so only the links and the entries of the
+    //unknown type are stat'ed, relative to the open directory.
+    //Entries read before the error are listed as well
+    static bool listDir(const fs::path& dirPath, std::vector<fs::path>& files,
+                        std::vector<fs::path> *subdirs, boost::system::error_code& ec);
+
+    //The same with the metadata of the files and of the subdirectories (NULL - not taken),
+    //it is taken relative to the open directory as the entries are read (stat of the
+    //full path on Windows). Metadata that can't be taken is not valid
+    static bool listDir(const fs::path& dirPath, std::vector<fs::path>& files, std::vector<FileStat> *fileStats,
+                        std::vector<fs::path> *subdirs, std::vector<FileStat> *subdirStats,
+                        boost::system::error_code& ec);
+private:
+    //deprecate copy constructor and assigment operator
+    DirectoryWalker(const DirectoryWalker&);
+    DirectoryWalker& operator=(const DirectoryWalker&);
+
+    struct DirNode;
+    typedef std::shared_ptr<DirNode> DirNodePtr;
+
+    //Subdirectory has its node, file has none
+    struct Entry {
+        fs::path   path;
+        DirNodePtr dir;
+        FileStat   stat;
+    };
+
+    enum DirState { DIR_QUEUED, DIR_READING, DIR_READY };
+
+    struct DirNode {
+        fs::path           path;
+        std::string        rel_path;  //'/' separated, empty for the root
+        size_t             depth;     //0 for the root
+        DirState           state;
+        std::vector<Entry> entries;
+    };
+
+    //Position of next() in the directory
+    struct Frame {
+        DirNodePtr node;
+        size_t     pos;
+    };
+
+    void scanDir(DirNodePtr node);
+    //Subdirectories are queued, the first one is returned instead if keepFirst is set
+    DirNodePtr readDir(DirNode& node, bool keepFirst);
+    void queueDirs(const std::vector<DirNodePtr>& dirs);
+
+
+    fs::path                    root_dir;
+    size_t                      thread_count;
+    FileFilter                  file_filter;
+    FileFilterSpec              filter_spec;
+    bool                        is_file_stats;
+    unsigned long long          root_device;
+
+    std::vector<fs::path>       file_paths;
+    size_t                      failed_count;
+
+    //Directories read ahead and the path of next() through them @{
+    std::vector<Frame>          frames;
+    std::mutex                  walk_mutex;
+    std::condition_variable     walk_cond;
+    //@}
+
+    //Destroyed first, its tasks use the mutex
+    std::unique_ptr<ThreadPool> pool;
+};
+
+//
+//
+//
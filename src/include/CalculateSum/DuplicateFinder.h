@@ -0,0 +1,90 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// DuplicateFinder.h	(V. Drozd)
+// src/CalculateSum/DuplicateFinder.h
+//
+
+//
+// Searches for files with the same content, reading as little as possible:
+// files are grouped by size, then by MD5 of their head and tail,
+// and only files that still collide are hashed completely
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include "CalculateSum/Types.h"
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <atomic>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declarations
+//
+
+class ThreadPool;
+
+struct DuplicateGroup {
+    long long             size;
+    std::string           checksum;
+    std::vector<fs::path> paths;
+};
+
+class DuplicateFinder {
+public:
+    DuplicateFinder(const std::vector<fs::path>& filePaths);
+
+    //Number of bytes from the head and from the tail hashed by the second stage
+    void setEdgeSize(size_t bytes);
+
+    bool process();
+
+    //Groups of the same files, the biggest files first
+    const std::vector<DuplicateGroup>& groups() const;
+
+    //Amount of data read by the last process()
+    long long bytesRead() const;
+
+    void writeGroups(std::ostream& out) const;
+private:
+    //deprecate copy constructor and assigment operator
+    DuplicateFinder(const DuplicateFinder&);
+    DuplicateFinder& operator=(const DuplicateFinder&);
+
+    struct Candidate {
+        size_t      idx;
+        long long   size;
+        std::string checksum;
+    };
+    typedef std::vector<Candidate> CandidateList;
+
+    void groupBySize(CandidateList& candidates);
+    void hashCandidates(ThreadPool& pool, CandidateList& candidates, bool isFull);
+    void dropUnique(CandidateList& candidates);
+
+
+    std::vector<fs::path>       file_paths;
+    size_t                      edge_size;
+
+    std::vector<DuplicateGroup> duplicate_groups;
+    std::atomic<long long>      bytes_read;
+};
+
+//
+//
+//
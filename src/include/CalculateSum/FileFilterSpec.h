@@ -0,0 +1,124 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileFilterSpec.h	(V. Drozd)
+// src/CalculateSum/FileFilterSpec.h
+//
+
+//
+// Files and directories of the tree that are logged: include and exclude
+// globs, size and modification time ranges, maximum depth and one file system.
+// DirectoryWalker tests directories before they are read, so excluded subtrees
+// (.git, build outputs, other mounts) cost nothing.
+//
+
+//
+// Globs are matched case sensitively against '/' separated paths relative to
+// the root of the tree:
+//   *      any characters except '/'
+//   ?      one character except '/'
+//   [a-z]  one character of the class ([!a-z] - not of the class)
+//   **     any characters including '/' ("**/" matches no directory too)
+// Pattern without '/' is matched against the name only (".git", "*.o"),
+// pattern with '/' against the whole relative path ("build/**/*.tmp"), the
+// leading '/' is ignored. Exclude pattern ending with '/' matches directories
+// only. Simple names and extensions are looked up in sets, not matched one by one.
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include "CalculateSum/Types.h"
+
+#include <string>
+#include <vector>
+#include <set>
+#include <ctime>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declarations
+//
+
+class FileFilterSpec {
+public:
+    FileFilterSpec();
+
+    //Only the files matched by some include pattern are logged (all if there are none)
+    void addInclude(const std::string& pattern);
+
+    //Excluded files are not logged, excluded directories are not read
+    void addExclude(const std::string& pattern);
+
+    //Files of the size (bytes) and of the modification time in [min, max]
+    void setSizeRange(unsigned long long minSize, unsigned long long maxSize);
+    void setTimeRange(std::time_t minTime, std::time_t maxTime);
+
+    //Levels of the tree that are read, 1 - the root directory only (0 - no limit)
+    void setMaxDepth(size_t depth);
+    size_t maxDepth() const;
+
+    //Directories of the other file systems (mount points) are not read.
+    //Windows walker never follows mounted folders (they are reparse points)
+    void setOneFileSystem(bool enable);
+    bool isOneFileSystem() const;
+
+    //Nothing is filtered
+    bool isEmpty() const;
+
+    //Size and time of the files are needed (one stat per file)
+    bool hasMetadataRange() const;
+
+    //Directory with this relative path and depth (its root is 0) is read
+    bool isDirIncluded(const std::string& relPath, size_t depth) const;
+
+    //File passes the include and exclude patterns
+    bool isNameIncluded(const std::string& relPath) const;
+
+    //File of this metadata is in the size and time ranges
+    bool isStatIncluded(const FileStat& stat) const;
+
+    //File with the relative path from the list is logged: all its directories are
+    //tested too, as if it was found by the walker (one file system is not tested)
+    bool isPathIncluded(const std::string& relPath, const FileStat& stat) const;
+private:
+    //Patterns sorted by the cheapest way to match them
+    struct GlobSet {
+        std::set<std::string>    names;       //literal names, e.g. ".git"
+        std::set<std::string>    extensions;  //"*.ext", stored as ".ext"
+        std::vector<std::string> name_globs;  //matched against the name
+        std::vector<std::string> path_globs;  //matched against the relative path
+
+        bool empty() const;
+        void add(const std::string& pattern);
+        bool match(const std::string& relPath) const;
+    };
+
+
+    GlobSet            include_files;
+    GlobSet            exclude_files;
+    GlobSet            exclude_dirs;
+
+    unsigned long long min_size;
+    unsigned long long max_size;
+    std::time_t        min_time;
+    std::time_t        max_time;
+
+    size_t             max_depth;
+    bool               is_one_file_system;
+};
+
+//
+//
+//
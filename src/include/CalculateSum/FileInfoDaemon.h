@@ -0,0 +1,124 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileInfoDaemon.h	(V. Drozd)
+// src/CalculateSum/FileInfoDaemon.h
+//
+
+//
+// Resident service that calculates file information on request
+// received over a local (unix domain) socket
+//
+
+//
+// Protocol is line based, every request is one line:
+//
+//   HASH <path>
+//   VERIFY <md5> <path>
+//
+// Requests are collected into batch until an empty line (or end of stream),
+// then they are calculated in parallel and answered in the same order:
+//
+//   OK <md5> <size> <path>
+//   MATCH <path>
+//   MISMATCH <md5> <path>
+//   ERROR <path>
+//
+// and the batch is finished by an empty line.
+//
+
+//
+// The socket is accessible by its owner only (mode 0600 on POSIX, on Windows
+// it takes the ACL of its directory). Existing file of the socket path is
+// replaced only if it is a socket too.
+//
+// Cached digest is returned while the size, the modification and change times
+// (in nanoseconds) and the identity of the file are the same. Files modified
+// during the last seconds are not cached, their times may not change on the
+// next write if the file system keeps them coarsely.
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include "CalculateSum/Types.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <ctime>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declarations
+//
+
+class ThreadPool;
+
+class FileInfoDaemon {
+public:
+    FileInfoDaemon(const fs::path& socketPath);
+    ~FileInfoDaemon();
+
+    //Maximum number of files which information is kept in memory
+    void setCacheLimit(size_t entries);
+
+    //Blocks until stop() is called or an error occurred
+    bool run();
+
+    //Can be called from any thread
+    void stop();
+private:
+    //deprecate copy constructor and assigment operator
+    FileInfoDaemon(const FileInfoDaemon&);
+    FileInfoDaemon& operator=(const FileInfoDaemon&);
+
+    struct CacheEntry {
+        FileStat    stat;
+        FileInfo    info;
+    };
+
+    //Platform dependent socket wrapper
+    struct Connection;
+
+    void serveClient(std::shared_ptr<Connection> client);
+    std::string processRequest(const std::string& request);
+    FileInfo getFileInfo(fs::path& fpath);
+
+
+    fs::path               socket_path;
+    size_t                 cache_limit;
+    std::atomic<bool>      is_stopped;
+
+    std::unique_ptr<ThreadPool> pool;
+
+    //Digests of the files that were already calculated @{
+    std::map<std::string, CacheEntry> cache;
+    std::mutex                        cache_mutex;
+    //@}
+
+    //Connected clients, every one is served by its own thread @{
+    std::set<std::shared_ptr<Connection>> clients;
+    std::mutex                            clients_mutex;
+    std::condition_variable               clients_done_condition;
+    //@}
+};
+
+//
+//
+//
@@ -0,0 +1,94 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileInfoDiff.h	(V. Drozd)
+// src/CalculateSum/FileInfoDiff.h
+//
+
+//
+// Differences between two logs made by FileInfoLogger
+//
+
+//
+// Logs are already sorted by path, so they are merged line by line:
+// the time is linear and the memory doesn't depend on the size of the logs.
+// Gzip compressed logs are read as well.
+// Every difference is reported by one line:
+//
+//   ADDED <name>
+//   REMOVED <name>
+//   MODIFIED <name>
+//
+// File is modified when its digest, size or state (failed or not) is changed,
+// the new creation date alone doesn't count.
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include "CalculateSum/Types.h"
+
+#include <string>
+#include <ostream>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declarations
+//
+
+class LogReader;
+
+class FileInfoDiff {
+public:
+    FileInfoDiff(const fs::path& oldLogPath, const fs::path& newLogPath);
+
+    //false if a log can't be read or isn't sorted
+    bool process(std::ostream& report);
+
+    //Counters of the last process() @{
+    size_t addedCount() const;
+    size_t removedCount() const;
+    size_t modifiedCount() const;
+    size_t unchangedCount() const;
+    //@}
+private:
+    //deprecate copy constructor and assigment operator
+    FileInfoDiff(const FileInfoDiff&);
+    FileInfoDiff& operator=(const FileInfoDiff&);
+
+    //Current line of the log
+    struct Cursor {
+        LogReader    *in;
+        FileInfo      info;
+        fs::path      name;
+        bool          is_valid;
+        bool          is_broken;
+    };
+
+    static void advance(Cursor& cursor);
+    static bool isModified(const FileInfo& oldInfo, const FileInfo& newInfo);
+
+
+    fs::path               old_log_path;
+    fs::path               new_log_path;
+
+    size_t                 added_count;
+    size_t                 removed_count;
+    size_t                 modified_count;
+    size_t                 unchanged_count;
+};
+
+//
+//
+//
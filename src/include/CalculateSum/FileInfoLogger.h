@@ -25,47 +25,276 @@
 #pragma once
 
 #include "CalculateSum/Types.h"
+#include "CalculateSum/ChunkList.h"
+#include "CalculateSum/Fingerprint.h"
+#include "CalculateSum/FileFilterSpec.h"
+#include "CalculateSum/FileRecord.h"
 
 #include <vector>
 #include <string>
+#include <map>
+#include <memory>
 
+#include <ctime>
+#include <chrono>
+#include <fstream>
 #include <future>
 #include <mutex>
+#include <deque>
 #include <condition_variable>
 
 ///////////////////////////////////////////////////////////////////////////////
 // %% BeginSection: declarations
 //
 
+class ThreadPool;
+struct FileIdentity;
+class KnownHashSet;
+class FileInfoSink;
+class DirectoryWalker;
+
 class FileInfoLogger {
 public:
     FileInfoLogger(std::vector<std::wstring>& filePaths, std::wstring& logFilePath);
     FileInfoLogger(std::vector<std::string>& filePaths,  std::string& logFilePath);
     FileInfoLogger(std::vector<fs::path>& filePaths,     fs::path& logFilePath);
 
+    //Files of the tree are hashed as soon as the walker finds them, instead of
+    //listing the whole tree first (the walker must outlive process()). Walker
+    //returns them in the order of the log, so the log is the same anyway
+    FileInfoLogger(DirectoryWalker& walker, fs::path& logFilePath);
+    ~FileInfoLogger();
+
+    //Reuse unchanged records of the existing log instead of hashing all files
+    //(plain or gzip compressed one)
+    void setIncrementalUpdate(bool enable);
+
+    //Journal every calculated record, so an interrupted run can be resumed
+    void setCheckpointing(bool enable);
+
+    //Abort the run when more than maxFailures files can't be calculated
+    //(failed files are logged with error code and reason)
+    void setFailureThreshold(size_t maxFailures);
+
+    //Number of files that were logged as failed by the last process()
+    size_t failedCount() const;
+
+    //File is logged as failed when its reading makes no progress for this time,
+    //output goes on and one more worker is started instead of the hung one.
+    //The system call can't be interrupted, so the hung thread is abandoned with
+    //its copy of the task data: process() doesn't wait for it, but the thread
+    //and its open file stay till the call returns or the process exits
+    void setStallTimeout(unsigned int seconds);
+
+    //File is logged as failed when it isn't read completely during this time
+    void setFileDeadline(unsigned int seconds);
+
+    //Hash hard links of the same file only once (enabled by default)
+    void setHardLinkDetection(bool enable);
+
+    //Log only the files of the shard index of count, file belongs to the shard
+    //by FNV-1a hash of its name, so every process (or host) gets the same split
+    void setShard(unsigned int index, unsigned int count);
+
+    //Mark files which digest is in the reference set (the set must outlive process())
+    void setKnownHashSet(const KnownHashSet *knownHashes);
+
+    //Number of files that were marked as known by the last process()
+    size_t knownCount() const;
+
+    //Compress the log by gzip with this level from 1 to 9 (0 - plain text log),
+    //compression runs in its own thread and doesn't hold back the output
+    void setCompression(int level);
+
+    //Record digests of every blockSize bytes of the files larger than one block
+    //to the sidecar <log>.blocks, see BlockHashList.h (0 - disabled)
+    void setBlockDigests(size_t blockSize);
+
+    //Split files into content defined chunks and record them to the sidecar
+    //<log>.chunks, see ChunkList.h
+    void setContentChunking(bool enable);
+
+    //Sidecar the chunks are recorded to, it follows the log even if the records
+    //are written to the other sink
+    const fs::path& chunkListPath() const;
+
+    //Log the sampled fingerprint instead of MD5 (NULL - MD5), it is labeled
+    //by its parameters in the log; blocks and chunks are not recorded then
+    void setFingerprint(const FingerprintSpec *spec);
+
+    //Log names relative to this directory, e.g. files found by DirectoryWalker
+    //(by default only the file name is logged)
+    void setRootDirectory(const fs::path& rootDir);
+
+    //Log only the files accepted by the spec, paths are relative to the root
+    //directory. The walker gets the spec, so it prunes excluded subtrees itself
+    void setFilterSpec(const FileFilterSpec& spec);
+
+    //Pass records to the sink instead of the log file (the sink must outlive process()),
+    //in the order of the log or in the order they are calculated (NULL sink is the log)
+    void setSink(FileInfoSink *sink, bool completionOrder = false);
+
     bool process();
 private:
     //deprecate copy constructor and assigment operator
     FileInfoLogger(const FileInfoLogger&);
     FileInfoLogger& operator=(const FileInfoLogger&);
 
+    //Defaults of all settings, the public constructors delegate to it
+    //(walker is NULL for the list of files)
+    FileInfoLogger(const fs::path& logFilePath, DirectoryWalker *walker);
+
+    typedef std::map<std::string, FileInfo> PrevInfoMap;
+
+    struct JournalEntry {
+        std::time_t mtime;
+        FileInfo    info;
+    };
+    typedef std::map<std::string, JournalEntry> JournalMap;
+
+    //Data used to decide how every new file is calculated (defined in .cpp)
+    struct TaskIntake;
+
+    //Per file data the result of the worker is moved to, taken before the task
+    //is queued, so the containers may grow while the worker runs
+    struct TaskSlots {
+        fs::path                       *path;
+        std::vector<std::string>       *block_digests;
+        std::vector<ChunkList::Chunk>  *chunks;
+    };
+
+    //Data of the file the worker reads, shared by the worker and the logger,
+    //so the worker that hangs can be abandoned (defined in .cpp)
+    struct TaskState;
+
     void internalInit();
-    bool writeResultsIntoLog();
-    FileInfo infoExtractorWrapper(fs::path& fpath, const size_t taskIdx);
+    void applyShard();
+    void applyFilter();
+    void takeFileStats();
+    bool isOwnFile(const fs::path& filePath) const;
+    bool isInShard(const fs::path& filePath) const;
+    void submitTask(const size_t taskIdx);
+    bool pullFiles(bool wait);
+    bool writeResults(ThreadPool& pool);
+    bool replaceOutput(std::time_t startTime);
+    void removeTmpOutput();
+    bool writeInOrder(ThreadPool& pool, FileInfoSink& out);
+    bool writeInCompletionOrder(ThreadPool& pool, FileInfoSink& out);
+    bool writeRecord(const size_t taskIdx, FileRecord& record, FileInfoSink& out);
+    bool waitResult(const size_t taskIdx, FileRecord& record);
+    bool waitCompleted(const std::vector<bool>& written, size_t& taskIdx, FileRecord& record);
+    void abandonTask(ThreadPool& pool, const size_t taskIdx);
+    FileRecord infoExtractorWrapper(const size_t taskIdx, const TaskSlots& slots, const std::shared_ptr<TaskState>& state);
 
+    //Incremental update helpers @{
+    bool loadPreviousLog(PrevInfoMap& prevInfo, std::time_t& prevTime);
+    bool reusePreviousInfo(const PrevInfoMap& prevInfo, std::time_t prevTime, const size_t taskIdx);
+    void loadPreviousBlocks();
+    void loadPreviousChunks();
+    //@}
 
-    std::vector<fs::path>  file_paths;
+    //Checkpoint helpers @{
+    void loadJournal(JournalMap& journalInfo);
+    bool reuseJournalInfo(const JournalMap& journalInfo, const size_t taskIdx);
+    void appendToJournal(const FileRecord& record, std::time_t mtime);
+    //@}
+
+    //Reused text is turned back into the record of the file, false if its digest is malformed
+    bool parseRecord(const FileInfo& finfo, const size_t taskIdx, FileRecord& record) const;
+    void setReadyResult(const size_t taskIdx, const FileRecord& record);
+    void notifyCompleted(const size_t taskIdx);
+    bool isLinkOfHashedFile(std::map<FileIdentity, size_t>& hashedFiles, const size_t taskIdx);
+    std::string shortName(const size_t taskIdx) const;
+
+
+    std::deque<fs::path>   file_paths;
+
+    //Metadata of every file, taken once and used by all checks and by the extractor
+    std::deque<FileStat>   file_stats;
     fs::path               log_file_path;
+    //The log and its sidecars are written here and renamed on success, so
+    //a failed run leaves the previous ones intact
+    fs::path               tmp_log_file_path;
+    fs::path               root_dir;
+
+    //Source of the files in the streaming mode, file_paths grows while they are calculated @{
+    DirectoryWalker       *file_walker;
+    bool                   is_walk_finished;
+    //@}
+
+    TaskIntake            *task_intake;
+
+    bool                   is_incremental;
+    bool                   is_checkpointing;
+
+    size_t                 failure_threshold;
+    size_t                 failed_count;
+
+    unsigned int           stall_timeout;
+    std::string            stall_reason;
+    unsigned int           file_deadline;
+
+    bool                   is_link_detection;
+
+    unsigned int           shard_index;
+    unsigned int           shard_count;
 
-    //Vector with all results for FileInfoExtract
-    std::vector<std::future<FileInfo>> results;
+    FileFilterSpec         filter_spec;
+
+    const KnownHashSet    *known_hashes;
+    size_t                 known_count;
+
+    FileInfoSink          *sink;
+    bool                   is_completion_order;
+
+    int                    compression_level;
+
+    //Digests of the blocks of every file (if block_size is set) @{
+    size_t                                             block_size;
+    fs::path                                           block_list_path;
+    fs::path                                           tmp_block_list_path;
+    std::ofstream                                      block_list;
+    std::deque<std::vector<std::string>>               block_digests;
+    std::map<std::string, std::vector<std::string>>    prev_blocks;
+    //@}
+
+    bool                                               is_fingerprint;
+    FingerprintSpec                                    fingerprint_spec;
+    std::string                                        digest_label;
+
+    //Content defined chunks of every file (if chunking is enabled) @{
+    bool                                               is_chunking;
+    fs::path                                           chunk_list_path;
+    fs::path                                           tmp_chunk_list_path;
+    std::ofstream                                      chunk_list;
+    std::deque<std::vector<ChunkList::Chunk>>          file_chunks;
+    std::map<std::string, std::vector<ChunkList::Chunk>> prev_chunks;
+    //@}
+
+    //Append-only journal of calculated records @{
+    fs::path                              journal_path;
+    std::ofstream                         journal;
+    size_t                                journal_pending;
+    std::chrono::steady_clock::time_point journal_flush_time;
+    std::mutex                            journal_mutex;
+    //@}
+
+    //All results of FileRecordExtract (deque, so the elements stay in place when it grows),
+    //they reference file_paths, root_dir and the labels above, the text is made by the sink
+    std::deque<std::future<FileRecord>> results;
+
+    //Indexes of the finished tasks (for completion order only) @{
+    std::deque<size_t>                    done_tasks;
+    std::mutex                            done_mutex;
+    std::condition_variable               done_cond;
+    //@}
 
-    //For synchronization of threads @{
-    bool    is_extract_done;
-    size_t  idx_extract_done_task;
+    //Watchdog data for each task (if timeouts are set, NULL till the task is queued)
+    std::deque<std::shared_ptr<TaskState>> task_states;
 
-    mutable std::mutex              extract_done_mutex;
-    mutable std::condition_variable extract_done_condition;
+    //Hard links are not hashed, they take result of the first link (by index) @{
+    std::deque<size_t>                 link_primary;
+    std::map<size_t, FileRecord>       linked_info;
     //@}
 };
 
@@ -0,0 +1,81 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileInfoMerger.h	(V. Drozd)
+// src/CalculateSum/FileInfoMerger.h
+//
+
+//
+// Combines partial logs of the sharded run into the final log
+//
+
+//
+// Every partial log is sorted by itself, so they are merged by k-way merge,
+// one line of every part is in memory at a time. The final log is the same
+// as the one made by the single run over all files, and its time is the time
+// of the oldest part, so the incremental update works after the merge too.
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include "CalculateSum/Types.h"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <fstream>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declarations
+//
+
+class LogReader;
+
+class FileInfoMerger {
+public:
+    FileInfoMerger(const std::vector<fs::path>& partPaths, const fs::path& logFilePath);
+
+    //false if a part can't be read, isn't sorted, or the same file is in two parts
+    bool process();
+
+    //Number of records in the final log
+    size_t recordCount() const;
+private:
+    //deprecate copy constructor and assigment operator
+    FileInfoMerger(const FileInfoMerger&);
+    FileInfoMerger& operator=(const FileInfoMerger&);
+
+    //Current line of the part
+    struct Cursor {
+        std::unique_ptr<LogReader>     in;
+        std::string                    line;
+        fs::path                       name;
+    };
+
+    //false at the end of the part or on error (is_broken is set then)
+    bool advance(Cursor& cursor);
+
+
+    std::vector<fs::path>  part_paths;
+    fs::path               log_file_path;
+
+    size_t                 record_count;
+    bool                   is_broken;
+};
+
+//
+//
+//
@@ -0,0 +1,169 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileInfoSink.h	(V. Drozd)
+// src/CalculateSum/FileInfoSink.h
+//
+
+//
+// Destination of the records calculated by FileInfoLogger
+//
+
+//
+// Logger calls open() once, writeRecord() for every file and close() at the end
+// (close() is not called if the run is aborted). All calls are made from
+// the thread that called FileInfoLogger::process(), so sinks need no locking.
+//
+// The logger keeps compact records, writeRecord() makes the text of the
+// FileInfo by default, sinks that write the text log make it of the record
+// itself.
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include "CalculateSum/Types.h"
+#include "CalculateSum/FileRecord.h"
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <memory>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declarations
+//
+
+class FileInfoSink {
+public:
+    virtual ~FileInfoSink() {}
+
+    virtual bool open() { return true; }
+
+    //false aborts the run
+    virtual bool write(const FileInfo& finfo) = 0;
+
+    //The record and what it references are valid during the call only
+    virtual bool writeRecord(const FileRecord& record) { return write(record.toFileInfo()); }
+
+    virtual bool close() { return true; }
+};
+
+//
+// Base of the sinks that write into the file
+//
+
+class FileSink : public FileInfoSink {
+public:
+    FileSink(const fs::path& filePath);
+
+    const fs::path& path() const;
+
+    virtual bool open();
+    virtual bool close();
+protected:
+    fs::path      file_path;
+    std::ofstream file;
+};
+
+//
+// The log in the format of FileInfo::toString(), the same as file_inf.log
+//
+
+class TextLogSink : public FileSink {
+public:
+    TextLogSink(const fs::path& filePath);
+
+    virtual bool write(const FileInfo& finfo);
+    virtual bool writeRecord(const FileRecord& record);
+};
+
+//
+// The text log compressed by gzip, lines are collected in blocks and compressed
+// by the separate thread, so the caller only waits if several blocks are queued
+//
+
+class GzipLogSink : public FileInfoSink {
+public:
+    //Level is from 1 (fastest) to 9 (smallest)
+    GzipLogSink(const fs::path& filePath, int level = 6);
+    ~GzipLogSink();
+
+    virtual bool open();
+    virtual bool write(const FileInfo& finfo);
+    virtual bool writeRecord(const FileRecord& record);
+    virtual bool close();
+private:
+    //deprecate copy constructor and assigment operator
+    GzipLogSink(const GzipLogSink&);
+    GzipLogSink& operator=(const GzipLogSink&);
+
+    //Compression thread and its queue of blocks
+    struct Pipeline;
+
+    //Line is added to the block, that is compressed when it is full
+    bool writeLine(const std::string& line);
+    bool flushBlock();
+
+
+    fs::path                  file_path;
+    int                       level;
+    std::string               block;
+    std::unique_ptr<Pipeline> pipeline;
+};
+
+//
+// One JSON object per line:
+//   {"name":"...","size":1,"created":"...","known":false,"md5":"..."}
+//   {"name":"...","size":1,"created":"...","known":false,"fingerprint":"...","type":"..."}
+//   {"name":"...","error":13,"reason":"..."}
+//
+
+class JsonLinesSink : public FileSink {
+public:
+    JsonLinesSink(const fs::path& filePath);
+
+    virtual bool write(const FileInfo& finfo);
+};
+
+//
+// CSV with the header line: name,size,created,digest,type,known,error,reason
+//
+
+class CsvSink : public FileSink {
+public:
+    CsvSink(const fs::path& filePath);
+
+    virtual bool open();
+    virtual bool write(const FileInfo& finfo);
+};
+
+//
+// Records are kept in memory, for library users
+//
+
+class VectorSink : public FileInfoSink {
+public:
+    virtual bool open();
+    virtual bool write(const FileInfo& finfo);
+
+    const std::vector<FileInfo>& records() const;
+private:
+    std::vector<FileInfo> record_list;
+};
+
+//
+//
+//
@@ -0,0 +1,121 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileInfoVerifier.h	(V. Drozd)
+// src/CalculateSum/FileInfoVerifier.h
+//
+
+//
+// Checks files of the directory against the known-good log (manifest),
+// plain or gzip compressed
+//
+
+//
+// Every problem is reported as soon as it is found, one line per file:
+//
+//   MISMATCH <name>
+//   MISSING <name>
+//   ERROR <name>, error: <code> (<reason>)
+//
+// so the report is in the order of completion, not in the order of the log.
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include "CalculateSum/Types.h"
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <ostream>
+#include <mutex>
+#include <condition_variable>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declarations
+//
+
+class ThreadPool;
+
+class FileInfoVerifier {
+public:
+    FileInfoVerifier(const fs::path& manifestPath, const fs::path& workDir);
+
+    //Stop at the first mismatched or missing file
+    void setFailFast(bool enable);
+
+    //false if the manifest can't be read, result of the check is in the counters
+    bool process(std::ostream& report);
+
+    //Counters of the last process() @{
+    size_t matchedCount() const;
+    size_t mismatchedCount() const;
+    size_t missingCount() const;
+    size_t failedCount() const;
+    //@}
+
+    //All files are present and match the manifest
+    bool isIntact() const;
+private:
+    //deprecate copy constructor and assigment operator
+    FileInfoVerifier(const FileInfoVerifier&);
+    FileInfoVerifier& operator=(const FileInfoVerifier&);
+
+    enum Status {
+        MATCHED,
+        MISMATCHED,
+        MISSING,
+        FAILED
+    };
+
+    struct Outcome {
+        size_t   idx;
+        Status   status;
+        FileInfo info;
+    };
+
+    bool loadManifest();
+    bool checkSize(const size_t idx, Outcome& outcome) const;
+    void verifyTask(fs::path& fpath, const size_t idx);
+
+    //Print the outcome, false if the run must be stopped
+    bool report(std::ostream& out, const Outcome& outcome);
+
+
+    fs::path               manifest_path;
+    fs::path               work_dir;
+
+    bool                   is_fail_fast;
+
+    //Records of the manifest and paths of the files they describe
+    std::vector<FileInfo>  expected;
+    std::vector<fs::path>  file_paths;
+
+    size_t                 matched_count;
+    size_t                 mismatched_count;
+    size_t                 missing_count;
+    size_t                 failed_count;
+
+    //Outcomes of the finished tasks in the order of completion @{
+    std::deque<Outcome>     done;
+    std::mutex              done_mutex;
+    std::condition_variable done_condition;
+    //@}
+};
+
+//
+//
+//
@@ -0,0 +1,107 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileInfoWatcher.h	(V. Drozd)
+// src/CalculateSum/FileInfoWatcher.h
+//
+
+//
+// Keeps the log of the directory up to date by watching filesystem events
+//
+
+//
+// The log is made by the same DirectoryWalker and FileFilterSpec as the normal
+// run, so it is the same as the log of the run with the same options. With
+// the recursive mode every directory of the tree is watched (one inotify watch
+// per directory on Linux, the subtree flag of ReadDirectoryChangesW on Windows),
+// new subdirectories make the tree rescanned (unchanged files are not rehashed).
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include "CalculateSum/Types.h"
+#include "CalculateSum/FileFilterSpec.h"
+
+#include <map>
+#include <set>
+#include <memory>
+#include <atomic>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declarations
+//
+
+class ThreadPool;
+
+class FileInfoWatcher {
+public:
+    FileInfoWatcher(const fs::path& workDir, const fs::path& logFilePath);
+    ~FileInfoWatcher();
+
+    //Events are collected until there are no new ones during this interval
+    void setDebounceInterval(unsigned int milliseconds);
+
+    //Log and watch the whole tree, names are relative to the working directory
+    void setRecursive(bool enable);
+
+    //Files and directories that are logged, as by FileInfoLogger::setFilterSpec()
+    void setFilterSpec(const FileFilterSpec& spec);
+
+    //Makes the initial log and then keeps it current
+    //Blocks until stop() is called or an error occurred
+    bool run();
+
+    //Can be called from any thread
+    void stop();
+private:
+    //deprecate copy constructor and assigment operator
+    FileInfoWatcher(const FileInfoWatcher&);
+    FileInfoWatcher& operator=(const FileInfoWatcher&);
+
+    //Platform dependent source of filesystem events (inotify or ReadDirectoryChangesW)
+    struct EventSource;
+
+    bool initialScan();
+    bool watchTree();
+    bool waitEvents(std::set<fs::path>& changedNames, bool& overflow);
+    //return number of events, 0 on timeout and -1 on error
+    int readEvents(std::set<fs::path>& changedNames, bool& overflow, unsigned int timeout);
+    //false if new directories appeared and the tree must be rescanned
+    bool updateEntries(ThreadPool& pool, const std::set<fs::path>& changedNames);
+    void eraseEntries(const fs::path& cpath);
+    bool writeLog();
+
+    bool isOwnFile(const fs::path& name) const;
+
+
+    fs::path               work_dir;
+    fs::path               log_file_path;
+    fs::path               tmp_log_file_path;
+
+    unsigned int           debounce_interval;
+    bool                   is_recursive;
+    FileFilterSpec         filter_spec;
+    std::atomic<bool>      is_stopped;
+
+    //Actual information about all files of the directory in alphabetical order
+    std::map<fs::path, FileInfo> entries;
+
+    std::unique_ptr<EventSource> events;
+};
+
+//
+//
+//
@@ -0,0 +1,81 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileRecord.h	(V. Drozd)
+// src/CalculateSum/FileRecord.h
+//
+
+//
+// Compact result of the file calculation: binary digest, size and creation
+// time as numbers and the reference to the path, no allocations per file.
+// FileInfo keeps the same fields as text (five strings per file), so the
+// logger keeps records while the files are calculated, and the text is made
+// only by the sink that writes it.
+//
+
+//
+// Path, root directory, digest type and error reason are referenced, not
+// copied: they belong to the producer (e.g. FileInfoLogger, then they are
+// valid during FileInfoSink::writeRecord() only).
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include "CalculateSum/Types.h"
+
+#include <string>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: type declarations
+//
+
+struct FileRecord {
+    const fs::path                      *path;
+    const fs::path                      *root_dir;        //name is relative to it (NULL - the file name)
+    const std::string                   *digest_type;     //NULL for MD5 (see FingerprintSpec::label())
+    const std::string                   *error_reason;    //NULL - the message of the error code
+    const boost::system::error_category *error_category;  //NULL - the generic one
+    unsigned long long                   size;
+    long long                            creation_time;
+    int                                  error_code;
+    unsigned char                        digest[16];
+    bool                                 is_correct;
+    bool                                 is_known;
+
+    FileRecord();
+
+    //Name of the file in the log
+    std::string shortName() const;
+
+    //Digest in hex, as it is logged
+    std::string checksum() const;
+
+    std::string errorReason() const;
+
+    //Line of the log, the same as toFileInfo().toString()
+    std::string toString() const;
+
+    //All fields as text
+    FileInfo toFileInfo() const;
+
+    //Path relative to the root ('/' separated), or just the file name if the
+    //root is empty or the file is outside of it
+    static std::string nameOf(const fs::path& rootDir, const fs::path& filePath);
+};
+
+//
+//
+//
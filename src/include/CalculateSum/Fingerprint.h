@@ -0,0 +1,147 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// Fingerprint.h	(V. Drozd)
+// src/CalculateSum/Fingerprint.h
+//
+
+//
+// Sampled fingerprint of the file for the quick change detection: MD5 of the
+// size, the head, the tail and the evenly spaced samples of the file, so no
+// more than head + tail + count * sample bytes are read whatever the file size.
+// Files not larger than that are read completely.
+//
+
+//
+// It is NOT a digest of the content: a change between the samples is missed.
+// So it is logged as the different digest type, with its parameters:
+//
+//   <name>, size is: ..., created: ..., FINGERPRINT[h<head>,t<tail>,<count>x<sample>]: <hex>
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include <string>
+#include <cstdio>
+#include <limits>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: type declarations
+//
+
+struct FingerprintSpec {
+    //More samples than that is not sampling anymore
+    static const size_t MAX_SAMPLE_COUNT = 4096;
+
+    size_t head_size;
+    size_t tail_size;
+    size_t sample_count;
+    size_t sample_size;
+
+    //64 KB head and tail and 16 samples of 64 KB, about 1 MB per file
+    FingerprintSpec()
+        : head_size(64 * 1024)
+        , tail_size(64 * 1024)
+        , sample_count(16)
+        , sample_size(64 * 1024)
+    {
+    }
+
+    //Type of the digest in the log
+    std::string label() const;
+
+    //Restore parameters from the label, false if it isn't a fingerprint label
+    //or its parameters are not valid
+    bool fromLabel(const std::string& label);
+
+    //Sample isn't empty, the count is up to MAX_SAMPLE_COUNT and the sampled
+    //size fits in the file offset
+    bool isValid() const;
+
+    //Bytes read from the larger file: head + tail + count * sample (valid spec only)
+    long long sampledSize() const;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: functions definitions
+//
+
+inline std::string FingerprintSpec::label() const
+{
+    return "FINGERPRINT[h" + std::to_string(head_size) + ",t" + std::to_string(tail_size) + "," +
+           std::to_string(sample_count) + "x" + std::to_string(sample_size) + "]";
+}
+
+inline bool FingerprintSpec::fromLabel(const std::string& label)
+{
+    unsigned long long head, tail, count, sample;
+    char end = 0;
+
+    if (std::sscanf(label.c_str(), "FINGERPRINT[h%llu,t%llu,%llux%llu%c", &head, &tail, &count, &sample, &end) != 5 ||
+        end != ']') {
+        return false;
+        //NOTREACHED
+    }
+
+    //Parameters are kept as they are, the label may come from the damaged manifest
+    const unsigned long long maxSize = std::numeric_limits<size_t>::max();
+    if (head > maxSize || tail > maxSize || count > maxSize || sample > maxSize) {
+        return false;
+        //NOTREACHED
+    }
+
+    FingerprintSpec spec;
+    spec.head_size    = static_cast<size_t>(head);
+    spec.tail_size    = static_cast<size_t>(tail);
+    spec.sample_count = static_cast<size_t>(count);
+    spec.sample_size  = static_cast<size_t>(sample);
+
+    if (!spec.isValid()) {
+        return false;
+        //NOTREACHED
+    }
+
+    *this = spec;
+    return true;
+}
+
+inline bool FingerprintSpec::isValid() const
+{
+    const unsigned long long maxSize = static_cast<unsigned long long>(std::numeric_limits<long long>::max());
+
+    if (!sample_size || sample_count > MAX_SAMPLE_COUNT) {
+        return false;
+        //NOTREACHED
+    }
+
+    if (head_size > maxSize || tail_size > maxSize - head_size) {
+        return false;
+        //NOTREACHED
+    }
+
+    const unsigned long long rest = maxSize - head_size - tail_size;
+    return !sample_count || sample_size <= rest / sample_count;
+}
+
+inline long long FingerprintSpec::sampledSize() const
+{
+    return static_cast<long long>(head_size) + static_cast<long long>(tail_size) +
+           static_cast<long long>(sample_count) * static_cast<long long>(sample_size);
+}
+
+//
+//
+//
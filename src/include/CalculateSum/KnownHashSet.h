@@ -0,0 +1,88 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// KnownHashSet.h	(V. Drozd)
+// src/CalculateSum/KnownHashSet.h
+//
+
+//
+// Reference set of MD5 digests (e.g. known malware or known good files),
+// which is looked up while the files are calculated
+//
+
+//
+// The set is kept in the binary table, which is memory mapped as is:
+//
+//   header     magic, version, number of digests, Bloom filter parameters
+//   filter     blocked Bloom filter (power of two bits, 512 bits per block)
+//   digests    sorted 16 byte digests
+//
+// Most of the files are not in the set and are rejected by the filter
+// with a single cache line read, the rest are found by binary search.
+// Numbers are stored in the native byte order.
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include "CalculateSum/Types.h"
+
+#include <string>
+#include <memory>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declarations
+//
+
+class KnownHashSet {
+public:
+    KnownHashSet();
+    ~KnownHashSet();
+
+    //Make the table from the text list, the first 32 digit hex number
+    //of every line is taken (md5sum output, plain lists and CSV are fine)
+    static bool build(const fs::path& listPath, const fs::path& tablePath);
+
+    bool open(const fs::path& tablePath);
+
+    //Number of digests in the set
+    unsigned long long size() const;
+
+    //Can be called from any thread
+    bool contains(const std::string& checksum) const;
+    bool contains(const unsigned char digest[16]) const;
+private:
+    //deprecate copy constructor and assigment operator
+    KnownHashSet(const KnownHashSet&);
+    KnownHashSet& operator=(const KnownHashSet&);
+
+    //Mapped view of the table file
+    struct Mapping;
+
+    std::unique_ptr<Mapping> mapping;
+
+    //Pointers into the mapped table @{
+    const unsigned char   *filter;
+    unsigned long long     filter_mask;      //number of blocks - 1
+    unsigned int           filter_hashes;
+
+    const unsigned char   *digests;
+    unsigned long long     digest_count;
+    //@}
+};
+
+//
+//
+//
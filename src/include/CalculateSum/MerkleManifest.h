@@ -0,0 +1,112 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// MerkleManifest.h	(V. Drozd)
+// src/CalculateSum/MerkleManifest.h
+//
+
+//
+// Manifest of the whole directory tree, where every directory has the digest
+// of its sorted children (their types, names and digests), so two trees are
+// compared top-down, descending only into the subtrees that differ
+//
+
+//
+// Manifest is the text file, one entry per line in the preorder,
+// children of every directory are sorted by name:
+//
+//   D <digest> <subtree bytes> <path>
+//   F <digest> <size> <path>
+//   E <error code> 0 <path>
+//
+// <path> is relative to the root ("." for the root itself, '/' separated),
+// <subtree bytes> is the length of the lines of all directory descendants,
+// so the comparison skips the equal subtree by one seek, without reading it.
+// E is the file or directory that can't be read, it never matches anything.
+// Symbolic links are not followed and not listed.
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include "CalculateSum/Types.h"
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <future>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declarations
+//
+
+class ThreadPool;
+
+class MerkleManifest {
+public:
+    MerkleManifest(const fs::path& rootDir);
+
+    //Hash all files of the tree and calculate digests of the directories
+    bool process();
+
+    //Write the manifest calculated by process()
+    bool write(const fs::path& manifestPath) const;
+
+    //Digest of the whole tree
+    std::string rootDigest() const;
+
+    //Number of files and directories that can't be read
+    size_t failedCount() const;
+
+    //Report differences of the new tree from the old one, one line per entry:
+    //  ADDED <path>, REMOVED <path>, MODIFIED <path> (directories end with '/')
+    //Only the subtrees with different digests are read
+    static bool compare(const fs::path& oldManifest, const fs::path& newManifest,
+                        std::ostream& report, size_t& differences);
+private:
+    //deprecate copy constructor and assigment operator
+    MerkleManifest(const MerkleManifest&);
+    MerkleManifest& operator=(const MerkleManifest&);
+
+    //Children of the directory are stored one after another,
+    //and always after the directory itself
+    struct Node {
+        char        type;           //'D', 'F' or 'E'
+        std::string path;
+        std::string digest;         //error code for 'E'
+        long long   number;         //subtree bytes for 'D', size for 'F'
+        size_t      first_child;
+        size_t      child_count;
+    };
+
+    void scanDir(ThreadPool& pool, const size_t dirIdx);
+    void finalize();
+    void writeNode(std::ostream& out, const size_t idx) const;
+
+    static std::string nodeLine(const Node& node);
+
+
+    fs::path               root_dir;
+
+    std::vector<Node>      nodes;
+    size_t                 failed_count;
+
+    //Pending digests of the files, by node index
+    std::vector<std::future<FileInfo>> results;
+};
+
+//
+//
+//
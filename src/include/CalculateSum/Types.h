@@ -34,22 +34,77 @@
 namespace fs = ::boost::filesystem;
 
 #include <string>
+#include <cstdlib>
+#include <ctime>
 
 ///////////////////////////////////////////////////////////////////////////////
 // %% BeginSection: type declarations
 //
 
+//
+// Metadata of the file taken by one call (statx on Linux), links are followed.
+// It is taken once per file and used by every stage of the logging
+//
+
+struct FileStat {
+    unsigned long long size;
+    std::time_t        mtime;
+    std::time_t        birth_time;  //the same as mtime if the file system doesn't keep it
+    long long          mtime_ns;    //nanoseconds since the epoch, as precise as the file system keeps it
+    long long          ctime_ns;    //status change time in nanoseconds (0 if it isn't known)
+    unsigned long long device;
+    unsigned long long inode;
+    unsigned long      links;
+    bool               is_directory;
+    bool               is_valid;    //false - not taken (or failed)
+
+    FileStat()
+        : size(0)
+        , mtime(0)
+        , birth_time(0)
+        , mtime_ns(0)
+        , ctime_ns(0)
+        , device(0)
+        , inode(0)
+        , links(0)
+        , is_directory(false)
+        , is_valid(false)
+    {
+    }
+};
+
 struct FileInfo {
     std::string full_name;
     std::string short_name;
     std::string checksum;
+
+    //Type of the checksum, empty for MD5 (see FingerprintSpec::label())
+    std::string digest_type;
     std::string creation;
     std::string human_readable_size;
     long long   size;
     bool        is_correct;
 
+    //Digest was found in the reference set of known hashes
+    bool        is_known;
+
+    //Why the information can't be calculated (for !is_correct only) @{
+    int         error_code;
+    std::string error_reason;
+    //@}
+
+    FileInfo()
+        : size(0)
+        , is_correct(false)
+        , is_known(false)
+        , error_code(0)
+    {
+    }
+
 	std::string toString();
 
+    //Restore fields from the line that was produced by toString()
+    bool fromString(const std::string& line);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -59,13 +114,115 @@ struct FileInfo {
 inline std::string FileInfo::toString()
 {
 	std::string retVal(short_name);
+
+    if (!is_correct) {
+        retVal += ", error: " + std::to_string(error_code);
+        retVal += " (" + error_reason + ")\n";
+        return (retVal);
+        //NOTREACHED
+    }
+
 	retVal += ", size is: " + human_readable_size;
 	retVal += ", created: " + creation;
-	retVal += ", MD5: " + checksum + "\n";
+	retVal += ", " + (digest_type.empty() ? std::string("MD5") : digest_type) + ": " + checksum;
+
+    if (is_known)
+        retVal += ", KNOWN";
+
+    retVal += "\n";
 
 	return (retVal);
 }
 
+inline bool FileInfo::fromString(const std::string& line)
+{
+    static const char sizeTag[]     = ", size is: ";
+    static const char creationTag[] = ", created: ";
+    static const char checksumTag[] = ", MD5: ";
+    static const char errorTag[]    = ", error: ";
+    static const char knownTag[]    = ", KNOWN";
+    static const char typeTag[]     = ", FINGERPRINT[";
+    static const char typeEndTag[]  = "]: ";
+
+    static const size_t sizeTagLen     = sizeof(sizeTag) - 1;
+    static const size_t creationTagLen = sizeof(creationTag) - 1;
+    static const size_t checksumTagLen = sizeof(checksumTag) - 1;
+    static const size_t errorTagLen    = sizeof(errorTag) - 1;
+    static const size_t knownTagLen    = sizeof(knownTag) - 1;
+
+    std::string text(line);
+    while (!text.empty() && (text.back() == '\n' || text.back() == '\r'))
+        text.erase(text.end() - 1);
+
+    //Mark of the known digest follows the digest itself
+    is_known = text.size() > knownTagLen && !text.compare(text.size() - knownTagLen, knownTagLen, knownTag);
+    if (is_known)
+        text.erase(text.size() - knownTagLen);
+
+    //Search from the end, because file name can contain any of the tags
+    auto checksumPos = text.rfind(checksumTag);
+    size_t checksumLen = checksumTagLen;
+    digest_type.clear();
+
+    //Digest of the other type is followed by its parameters
+    auto typePos = text.rfind(typeTag);
+    if (typePos != std::string::npos && (checksumPos == std::string::npos || typePos > checksumPos)) {
+        auto typeEnd = text.find(typeEndTag, typePos);
+
+        if (typeEnd != std::string::npos) {
+            checksumPos = typePos;
+            checksumLen = typeEnd + sizeof(typeEndTag) - 1 - typePos;
+            digest_type = text.substr(typePos + 2, typeEnd + 1 - typePos - 2);
+        }
+    }
+
+    if (checksumPos == std::string::npos) {
+        //It can be record about the failed file: "<name>, error: <code> (<reason>)"
+        auto errorPos = text.rfind(errorTag);
+        if (errorPos == std::string::npos || text.back() != ')') {
+            return false;
+            //NOTREACHED
+        }
+
+        auto reasonPos = text.find(" (", errorPos + errorTagLen);
+        if (reasonPos == std::string::npos) {
+            return false;
+            //NOTREACHED
+        }
+
+        short_name   = text.substr(0, errorPos);
+        error_code   = std::atoi(text.c_str() + errorPos + errorTagLen);
+        error_reason = text.substr(reasonPos + 2, text.size() - reasonPos - 3);
+        size         = 0;
+        is_correct   = false;
+        is_known     = false;
+
+        return (true);
+        //NOTREACHED
+    }
+
+    auto creationPos = text.rfind(creationTag, checksumPos);
+    if (creationPos == std::string::npos) {
+        return false;
+        //NOTREACHED
+    }
+
+    auto sizePos = text.rfind(sizeTag, creationPos);
+    if (sizePos == std::string::npos) {
+        return false;
+        //NOTREACHED
+    }
+
+    short_name          = text.substr(0, sizePos);
+    human_readable_size = text.substr(sizePos + sizeTagLen, creationPos - sizePos - sizeTagLen);
+    creation            = text.substr(creationPos + creationTagLen, checksumPos - creationPos - creationTagLen);
+    checksum            = text.substr(checksumPos + checksumLen);
+    size                = 0;
+    is_correct          = true;
+
+    return (true);
+}
+
 //
 //
 //
@@ -0,0 +1,518 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// BinaryManifest.cpp    (V. Drozd)
+// src/modules/FileInfoLogger/src/BinaryManifest.cpp
+//
+
+//
+// Compact binary form of the log with memory mapped indexes
+//
+
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "CalculateSum/BinaryManifest.h"
+#include "FileInfoExtractor.h"
+#include "LogReader.h"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: variable definitions
+//
+
+static const char     _s_manifestMagic[8] = { 'C', 'S', 'U', 'M', 'B', 'M', 'F', 0 };
+static const uint32_t _s_manifestVersion  = 1;
+
+static const size_t   _s_digestSize = 16;
+
+//Record flags
+static const unsigned int _s_flagCorrect = 0x1;
+static const unsigned int _s_flagKnown   = 0x2;
+static const unsigned int _s_flagTyped   = 0x4;
+
+//Sections in the order of the file
+enum {
+    SECTION_DIGESTS,
+    SECTION_SIZES,
+    SECTION_NAMES,
+    SECTION_REASONS,
+    SECTION_DATES,
+    SECTION_ERRORS,
+    SECTION_FLAGS,
+    SECTION_NAME_INDEX,
+    SECTION_DIGEST_INDEX,
+    SECTION_STRINGS,
+    SECTION_COUNT
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local declarations
+//
+
+struct ManifestHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t record_count;
+    uint64_t digest_index_count;    //failed files have no digest
+    uint64_t strings_size;
+    uint64_t offsets[SECTION_COUNT];
+};
+
+//
+// Creation date "d/m/yyyy" packed as yyyymmdd and back
+//
+
+static unsigned int _t_pack_date(const std::string& creation);
+static std::string _t_unpack_date(unsigned int date);
+
+//
+// Write the section and pad it to 8 bytes
+//
+
+static void _t_write_section(std::ostream& out, const void *data, uint64_t size);
+
+static inline uint64_t _t_align(uint64_t size)
+{
+    return (size + 7) & ~static_cast<uint64_t>(7);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: mapping
+//
+
+struct BinaryManifest::Mapping {
+    boost::interprocess::file_mapping  file;
+    boost::interprocess::mapped_region region;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: writer definitions
+//
+
+BinaryManifestWriter::BinaryManifestWriter(const fs::path& manifestPath)
+    : manifest_path(manifestPath)
+    , strings(1, '\0')
+{
+}
+
+void BinaryManifestWriter::add(const FileInfo& finfo)
+{
+    unsigned char digest[_s_digestSize] = { 0 };
+    unsigned int flag = 0;
+    long long size = 0;
+    unsigned int date = 0;
+
+    if (finfo.is_correct && finfo.checksum.size() == 2 * _s_digestSize &&
+        parseMD5(finfo.checksum.c_str(), digest)) {
+        flag |= _s_flagCorrect;
+
+        //Records read from the text log have only the human readable size
+        size = finfo.size ? finfo.size : std::max(0LL, parseHumanReadableSize(finfo.human_readable_size));
+        date = _t_pack_date(finfo.creation);
+
+        if (finfo.is_known)
+            flag |= _s_flagKnown;
+
+        if (!finfo.digest_type.empty())
+            flag |= _s_flagTyped;
+    }
+
+    digests.insert(digests.end(), digest, digest + _s_digestSize);
+    sizes.push_back(size);
+    names.push_back(addString(finfo.short_name));
+    //Correct record keeps the type of its digest there (0 - MD5)
+    if (flag & _s_flagCorrect)
+        reasons.push_back((flag & _s_flagTyped) ? addString(finfo.digest_type) : 0);
+    else
+        reasons.push_back(addString(finfo.error_reason));
+
+    dates.push_back(date);
+    errors.push_back((flag & _s_flagCorrect) ? 0 : finfo.error_code);
+    flags.push_back(flag);
+}
+
+bool BinaryManifestWriter::close()
+{
+    const size_t count = flags.size();
+
+    //Indexes are sorted by plain byte order, which is the same on every platform
+    std::vector<unsigned int> nameIndex(count);
+    std::vector<unsigned int> digestIndex;
+
+    for (size_t i = 0; i < count; i++) {
+        nameIndex[i] = static_cast<unsigned int>(i);
+        //Fingerprints are not searched by the content digest
+        if ((flags[i] & _s_flagCorrect) && !(flags[i] & _s_flagTyped))
+            digestIndex.push_back(static_cast<unsigned int>(i));
+    }
+
+    const char *text = strings.c_str();
+    std::sort(nameIndex.begin(), nameIndex.end(), [this, text](unsigned int a, unsigned int b) {
+        return std::strcmp(text + names[a], text + names[b]) < 0;
+    });
+
+    const unsigned char *digestData = digests.data();
+    std::stable_sort(digestIndex.begin(), digestIndex.end(), [digestData](unsigned int a, unsigned int b) {
+        return std::memcmp(digestData + a * _s_digestSize, digestData + b * _s_digestSize, _s_digestSize) < 0;
+    });
+
+    const uint64_t sectionSizes[SECTION_COUNT] = {
+        count * _s_digestSize,
+        count * sizeof(long long),
+        count * sizeof(unsigned long long),
+        count * sizeof(unsigned long long),
+        count * sizeof(unsigned int),
+        count * sizeof(int),
+        count * sizeof(unsigned int),
+        count * sizeof(unsigned int),
+        digestIndex.size() * sizeof(unsigned int),
+        strings.size()
+    };
+
+    const void *sectionData[SECTION_COUNT] = {
+        digests.data(), sizes.data(), names.data(), reasons.data(), dates.data(),
+        errors.data(), flags.data(), nameIndex.data(), digestIndex.data(), strings.data()
+    };
+
+    ManifestHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, _s_manifestMagic, sizeof(header.magic));
+    header.version = _s_manifestVersion;
+    header.record_count = count;
+    header.digest_index_count = digestIndex.size();
+    header.strings_size = strings.size();
+
+    uint64_t offset = _t_align(sizeof(header));
+    for (size_t i = 0; i < SECTION_COUNT; i++) {
+        header.offsets[i] = offset;
+        offset += _t_align(sectionSizes[i]);
+    }
+
+    std::ofstream file(manifest_path.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+        //NOTREACHED
+    }
+
+    _t_write_section(file, &header, sizeof(header));
+    for (size_t i = 0; i < SECTION_COUNT; i++)
+        _t_write_section(file, sectionData[i], sectionSizes[i]);
+
+    file.close();
+    return !file.fail();
+}
+
+bool BinaryManifestWriter::convert(const fs::path& logPath, const fs::path& manifestPath)
+{
+    LogReader file;
+    if (!file.open(logPath)) {
+        return false;
+        //NOTREACHED
+    }
+
+    BinaryManifestWriter writer(manifestPath);
+
+    std::string line;
+    while (file.getline(line)) {
+        FileInfo finfo;
+        if (!finfo.fromString(line)) {
+            return false;
+            //NOTREACHED
+        }
+
+        writer.add(finfo);
+    }
+
+    if (file.is_broken()) {
+        return false;
+        //NOTREACHED
+    }
+
+    return writer.close();
+}
+
+size_t BinaryManifestWriter::addString(const std::string& text)
+{
+    size_t retVal = strings.size();
+
+    strings += text;
+    strings += '\0';
+
+    return (retVal);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: reader definitions
+//
+
+BinaryManifest::BinaryManifest()
+    : record_count(0)
+    , digests(NULL)
+    , sizes(NULL)
+    , names(NULL)
+    , reasons(NULL)
+    , dates(NULL)
+    , errors(NULL)
+    , flags(NULL)
+    , name_index(NULL)
+    , digest_index(NULL)
+    , digest_index_count(0)
+    , strings(NULL)
+    , strings_size(0)
+{
+}
+
+BinaryManifest::~BinaryManifest()
+{
+}
+
+bool BinaryManifest::open(const fs::path& manifestPath)
+{
+    namespace ipc = boost::interprocess;
+
+    mapping.reset();
+    record_count = 0;
+
+    std::unique_ptr<Mapping> newMapping(new Mapping);
+
+    //Interprocess library reports errors only by exceptions
+    try {
+        ipc::file_mapping file(manifestPath.string().c_str(), ipc::read_only);
+        ipc::mapped_region region(file, ipc::read_only);
+
+        newMapping->file.swap(file);
+        newMapping->region.swap(region);
+    }
+    catch (const ipc::interprocess_exception&) {
+        return false;
+        //NOTREACHED
+    }
+
+    const char *data = static_cast<const char *>(newMapping->region.get_address());
+    const uint64_t dataSize = newMapping->region.get_size();
+
+    ManifestHeader header;
+    if (dataSize < sizeof(header)) {
+        return false;
+        //NOTREACHED
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    if (std::memcmp(header.magic, _s_manifestMagic, sizeof(header.magic)) ||
+        header.version != _s_manifestVersion || header.digest_index_count > header.record_count ||
+        !header.strings_size) {
+        return false;
+        //NOTREACHED
+    }
+
+    const uint64_t count = header.record_count;
+    const uint64_t sectionSizes[SECTION_COUNT] = {
+        count * _s_digestSize,
+        count * sizeof(long long),
+        count * sizeof(unsigned long long),
+        count * sizeof(unsigned long long),
+        count * sizeof(unsigned int),
+        count * sizeof(int),
+        count * sizeof(unsigned int),
+        count * sizeof(unsigned int),
+        header.digest_index_count * sizeof(unsigned int),
+        header.strings_size
+    };
+
+    //Truncated or damaged manifest
+    for (size_t i = 0; i < SECTION_COUNT; i++) {
+        if ((header.offsets[i] & 7) || header.offsets[i] > dataSize ||
+            sectionSizes[i] > dataSize - header.offsets[i]) {
+            return false;
+            //NOTREACHED
+        }
+    }
+
+    strings      = data + header.offsets[SECTION_STRINGS];
+    strings_size = header.strings_size;
+
+    //All strings must be terminated inside the table
+    if (strings[strings_size - 1]) {
+        return false;
+        //NOTREACHED
+    }
+
+    digests      = reinterpret_cast<const unsigned char *>(data + header.offsets[SECTION_DIGESTS]);
+    sizes        = reinterpret_cast<const long long *>(data + header.offsets[SECTION_SIZES]);
+    names        = reinterpret_cast<const unsigned long long *>(data + header.offsets[SECTION_NAMES]);
+    reasons      = reinterpret_cast<const unsigned long long *>(data + header.offsets[SECTION_REASONS]);
+    dates        = reinterpret_cast<const unsigned int *>(data + header.offsets[SECTION_DATES]);
+    errors       = reinterpret_cast<const int *>(data + header.offsets[SECTION_ERRORS]);
+    flags        = reinterpret_cast<const unsigned int *>(data + header.offsets[SECTION_FLAGS]);
+    name_index   = reinterpret_cast<const unsigned int *>(data + header.offsets[SECTION_NAME_INDEX]);
+    digest_index = reinterpret_cast<const unsigned int *>(data + header.offsets[SECTION_DIGEST_INDEX]);
+
+    digest_index_count = static_cast<size_t>(header.digest_index_count);
+    record_count = static_cast<size_t>(count);
+
+    mapping.swap(newMapping);
+
+    return true;
+}
+
+size_t BinaryManifest::size() const
+{
+    return record_count;
+}
+
+FileInfo BinaryManifest::record(size_t idx) const
+{
+    FileInfo finfo;
+
+    if (idx >= record_count) {
+        return finfo;
+        //NOTREACHED
+    }
+
+    finfo.short_name = nameOf(idx);
+    finfo.full_name = finfo.short_name;
+    finfo.is_correct = !!(flags[idx] & _s_flagCorrect);
+    finfo.is_known = !!(flags[idx] & _s_flagKnown);
+
+    if (!finfo.is_correct) {
+        finfo.error_code = errors[idx];
+        finfo.error_reason = (reasons[idx] < strings_size) ? strings + reasons[idx] : "";
+        return finfo;
+        //NOTREACHED
+    }
+
+    finfo.checksum = formatMD5(digests + idx * _s_digestSize);
+    if ((flags[idx] & _s_flagTyped) && reasons[idx] < strings_size)
+        finfo.digest_type = strings + reasons[idx];
+    finfo.size = sizes[idx];
+    finfo.human_readable_size = getHumanReadableSize(finfo.size);
+    finfo.creation = _t_unpack_date(dates[idx]);
+
+    return finfo;
+}
+
+bool BinaryManifest::findByName(const std::string& name, FileInfo& finfo) const
+{
+    const char *key = name.c_str();
+
+    auto finded = std::lower_bound(
+        name_index,
+        name_index + record_count,
+        key,
+        [this](unsigned int idx, const char *key) { return std::strcmp(nameOf(idx), key) < 0; }
+    );
+
+    if (finded == name_index + record_count || std::strcmp(nameOf(*finded), key)) {
+        return false;
+        //NOTREACHED
+    }
+
+    finfo = record(*finded);
+    return true;
+}
+
+std::vector<FileInfo> BinaryManifest::findByDigest(const std::string& checksum) const
+{
+    std::vector<FileInfo> retVal;
+    unsigned char digest[_s_digestSize];
+
+    if (checksum.size() != 2 * _s_digestSize || !parseMD5(checksum.c_str(), digest)) {
+        return retVal;
+        //NOTREACHED
+    }
+
+    const unsigned char *records = digests;
+    auto finded = std::lower_bound(
+        digest_index,
+        digest_index + digest_index_count,
+        digest,
+        [records](unsigned int idx, const unsigned char *key) {
+            return std::memcmp(records + idx * _s_digestSize, key, _s_digestSize) < 0;
+        }
+    );
+
+    for (; finded != digest_index + digest_index_count; ++finded) {
+        if (std::memcmp(records + *finded * _s_digestSize, digest, _s_digestSize))
+            break;
+
+        retVal.push_back(record(*finded));
+    }
+
+    return retVal;
+}
+
+bool BinaryManifest::writeText(std::ostream& out) const
+{
+    for (size_t i = 0; i < record_count && out; i++)
+        out << record(i).toString();
+
+    return !out.fail();
+}
+
+const char *BinaryManifest::nameOf(size_t idx) const
+{
+    return (names[idx] < strings_size) ? strings + names[idx] : "";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local definitions
+//
+
+static unsigned int _t_pack_date(const std::string& creation)
+{
+    unsigned int day = 0, month = 0, year = 0;
+
+    if (std::sscanf(creation.c_str(), "%u/%u/%u", &day, &month, &year) != 3) {
+        return 0;
+        //NOTREACHED
+    }
+
+    return (year * 10000 + month * 100 + day);
+}
+
+static std::string _t_unpack_date(unsigned int date)
+{
+    std::string retVal;
+
+    retVal += std::to_string(date % 100) + "/";
+    retVal += std::to_string(date / 100 % 100) + "/";
+    retVal += std::to_string(date / 10000);
+
+    return (retVal);
+}
+
+static void _t_write_section(std::ostream& out, const void *data, uint64_t size)
+{
+    static const char padding[8] = { 0 };
+
+    if (size)
+        out.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+
+    out.write(padding, static_cast<std::streamsize>(_t_align(size) - size));
+}
+
+//
+//
+//
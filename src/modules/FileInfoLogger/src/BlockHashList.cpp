@@ -0,0 +1,229 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// BlockHashList.cpp    (V. Drozd)
+// src/modules/FileInfoLogger/src/BlockHashList.cpp
+//
+
+//
+// Digests of the fixed size blocks of the large files
+//
+
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "CalculateSum/BlockHashList.h"
+#include "FileInfoExtractor.h"
+#include "LogReader.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <sstream>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: public function member definitions
+//
+
+BlockHashList::BlockHashList()
+    : checked_count(0)
+    , damaged_count(0)
+    , failed_count(0)
+    , missing_count(0)
+    , resized_count(0)
+{
+}
+
+bool BlockHashList::load(const fs::path& listPath)
+{
+    entry_list.clear();
+
+    LogReader file;
+    if (!file.open(listPath)) {
+        return false;
+        //NOTREACHED
+    }
+
+    std::string line;
+    while (file.getline(line)) {
+        Entry entry;
+        if (!parse(line, entry)) {
+            return false;
+            //NOTREACHED
+        }
+
+        entry_list.push_back(entry);
+    }
+
+    return !file.is_broken();
+}
+
+const std::vector<BlockHashList::Entry>& BlockHashList::entries() const
+{
+    return entry_list;
+}
+
+std::string BlockHashList::format(const Entry& entry)
+{
+    std::string retVal = std::to_string(entry.block_size) + " " + std::to_string(entry.size);
+
+    for (size_t i = 0; i < entry.digests.size(); i++)
+        retVal += " " + entry.digests[i];
+
+    retVal += " " + entry.name;
+    return (retVal);
+}
+
+bool BlockHashList::parse(const std::string& line, Entry& entry)
+{
+    std::istringstream text(line);
+
+    if (!(text >> entry.block_size >> entry.size) || !entry.block_size || entry.size < 0) {
+        return false;
+        //NOTREACHED
+    }
+
+    size_t count = static_cast<size_t>((entry.size + entry.block_size - 1) / entry.block_size);
+    unsigned char digest[16];
+
+    entry.digests.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        if (!(text >> entry.digests[i]) || entry.digests[i].size() != 32 || !parseMD5(entry.digests[i].c_str(), digest)) {
+            return false;
+            //NOTREACHED
+        }
+    }
+
+    //The rest of the line is the name, it may contain spaces
+    if (text.get() != ' ' || !std::getline(text, entry.name) || entry.name.empty()) {
+        return false;
+        //NOTREACHED
+    }
+
+    return true;
+}
+
+void BlockHashList::verify(const fs::path& workDir, std::ostream& report)
+{
+    checked_count = damaged_count = failed_count = missing_count = resized_count = 0;
+
+    //Current size of every listed file, -1 if it is missing
+    std::vector<long long> sizes(entry_list.size(), -1);
+
+    //Digests of all blocks of all files, in the order of the list
+    std::vector<std::future<std::string>> results;
+
+    {
+        ThreadPool pool(std::max(1U, std::thread::hardware_concurrency() - 1));
+
+        for (size_t i = 0; i < entry_list.size(); i++) {
+            const Entry& entry = entry_list[i];
+            fs::path cpath = workDir / entry.name;
+
+            boost::system::error_code ec;
+            auto size = fs::file_size(cpath, ec);
+            if (ec)
+                continue;
+
+            sizes[i] = static_cast<long long>(size);
+
+            for (size_t j = 0; j < entry.digests.size(); j++) {
+                long long offset = static_cast<long long>(j) * entry.block_size;
+                size_t length = entry.block_size;
+
+                results.push_back(pool.addTask(
+                    [cpath, offset, length]() {
+                        boost::system::error_code ec;
+                        std::string digest = getFileRangeMD5(cpath, offset, length, ec);
+                        return ec ? std::string() : digest;
+                    }
+                ));
+            }
+        }
+
+        size_t next = 0;
+
+        //Blocks are reported as they are checked, the pool goes on meanwhile
+        for (size_t i = 0; i < entry_list.size(); i++) {
+            const Entry& entry = entry_list[i];
+
+            if (sizes[i] < 0) {
+                report << "MISSING " << entry.name << "\n";
+                missing_count++;
+                continue;
+            }
+
+            //Listed blocks are checked anyway, the appended data isn't covered by them
+            if (sizes[i] != entry.size) {
+                report << "RESIZED " << entry.name << "\n";
+                resized_count++;
+            }
+
+            for (size_t j = 0; j < entry.digests.size(); j++) {
+                std::string digest = results[next++].get();
+
+                long long offset = static_cast<long long>(j) * entry.block_size;
+                long long length = std::min<long long>(entry.block_size, entry.size - offset);
+
+                checked_count++;
+
+                if (digest.empty()) {
+                    report << "UNREADABLE " << entry.name << " " << offset << " " << length << "\n";
+                    failed_count++;
+                }
+                else if (digest != entry.digests[j]) {
+                    report << "DAMAGED " << entry.name << " " << offset << " " << length << "\n";
+                    damaged_count++;
+                }
+            }
+        }
+    }
+
+    report.flush();
+}
+
+size_t BlockHashList::checkedCount() const
+{
+    return checked_count;
+}
+
+size_t BlockHashList::damagedCount() const
+{
+    return damaged_count;
+}
+
+size_t BlockHashList::failedCount() const
+{
+    return failed_count;
+}
+
+size_t BlockHashList::missingCount() const
+{
+    return missing_count;
+}
+
+size_t BlockHashList::resizedCount() const
+{
+    return resized_count;
+}
+
+bool BlockHashList::isIntact() const
+{
+    return !damaged_count && !failed_count && !missing_count && !resized_count;
+}
+
+//
+//
+//
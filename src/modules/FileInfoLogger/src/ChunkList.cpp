@@ -0,0 +1,153 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// ChunkList.cpp    (V. Drozd)
+// src/modules/FileInfoLogger/src/ChunkList.cpp
+//
+
+//
+// Content defined chunks of the files and the estimate of deduplication
+//
+
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "CalculateSum/ChunkList.h"
+#include "FileInfoExtractor.h"
+#include "LogReader.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <sstream>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: public function member definitions
+//
+
+double ChunkList::DedupStats::ratio() const
+{
+    return unique_bytes ? static_cast<double>(total_bytes) / unique_bytes : 1.0;
+}
+
+std::string ChunkList::format(const Entry& entry)
+{
+    std::string retVal = std::to_string(entry.size);
+
+    for (size_t i = 0; i < entry.chunks.size(); i++)
+        retVal += " " + entry.chunks[i].digest + ":" + std::to_string(entry.chunks[i].length);
+
+    retVal += " " + entry.name;
+    return (retVal);
+}
+
+bool ChunkList::parse(const std::string& line, Entry& entry)
+{
+    std::istringstream text(line);
+
+    if (!(text >> entry.size) || entry.size < 0) {
+        return false;
+        //NOTREACHED
+    }
+
+    entry.chunks.clear();
+
+    //Chunks are read until they cover the whole file
+    unsigned long long covered = 0;
+    unsigned char digest[16];
+
+    while (covered < static_cast<unsigned long long>(entry.size)) {
+        std::string token;
+        if (!(text >> token) || token.size() < 34 || token[32] != ':' || !parseMD5(token.c_str(), digest)) {
+            return false;
+            //NOTREACHED
+        }
+
+        Chunk chunk;
+        chunk.digest = token.substr(0, 32);
+        chunk.length = static_cast<size_t>(std::strtoull(token.c_str() + 33, NULL, 10));
+
+        if (!chunk.length) {
+            return false;
+            //NOTREACHED
+        }
+
+        covered += chunk.length;
+        entry.chunks.push_back(chunk);
+    }
+
+    //The rest of the line is the name, it may contain spaces
+    if (covered != static_cast<unsigned long long>(entry.size) ||
+        text.get() != ' ' || !std::getline(text, entry.name) || entry.name.empty()) {
+        return false;
+        //NOTREACHED
+    }
+
+    return true;
+}
+
+bool ChunkList::analyze(const fs::path& listPath, DedupStats& stats)
+{
+    stats.total_bytes = stats.unique_bytes = 0;
+    stats.total_chunks = stats.unique_chunks = 0;
+
+    LogReader file;
+    if (!file.open(listPath)) {
+        return false;
+        //NOTREACHED
+    }
+
+    //Binary digest and length of every chunk, 24 bytes each
+    typedef std::pair<std::array<unsigned char, 16>, unsigned long long> ChunkKey;
+    std::vector<ChunkKey> keys;
+
+    std::string line;
+    while (file.getline(line)) {
+        Entry entry;
+        if (!parse(line, entry)) {
+            return false;
+            //NOTREACHED
+        }
+
+        for (size_t i = 0; i < entry.chunks.size(); i++) {
+            ChunkKey key;
+            parseMD5(entry.chunks[i].digest.c_str(), key.first.data());
+            key.second = entry.chunks[i].length;
+            keys.push_back(key);
+
+            stats.total_bytes += entry.chunks[i].length;
+        }
+    }
+
+    if (file.is_broken()) {
+        return false;
+        //NOTREACHED
+    }
+
+    stats.total_chunks = keys.size();
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    stats.unique_chunks = keys.size();
+    for (size_t i = 0; i < keys.size(); i++)
+        stats.unique_bytes += keys[i].second;
+
+    return true;
+}
+
+//
+//
+//
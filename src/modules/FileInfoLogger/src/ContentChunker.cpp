@@ -0,0 +1,170 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// ContentChunker.cpp    (V. Drozd)
+// src/modules/FileInfoLogger/src/ContentChunker.cpp
+//
+
+//
+// Content defined chunking of the file data (FastCDC)
+//
+
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "ContentChunker.h"
+#include "FileInfoExtractor.h"
+
+#include <algorithm>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: variable definitions
+//
+
+//Sizes of the chunk
+static const size_t _s_minChunkSize = 2 * 1024;
+static const size_t _s_avgChunkSize = 8 * 1024;
+static const size_t _s_maxChunkSize = 64 * 1024;
+
+//Masks of 15 and 11 bits spread over the hash (FastCDC with 8 KB average)
+static const unsigned long long _s_maskSmall = 0x0000d9f003530000ULL;
+static const unsigned long long _s_maskLarge = 0x0000d90003530000ULL;
+
+//
+// Random value for every byte, made by splitmix64 from the fixed seed,
+// so the boundaries are the same in every process
+//
+
+static struct GearTable {
+    unsigned long long values[256];
+
+    GearTable()
+    {
+        unsigned long long seed = 0x9e3779b97f4a7c15ULL;
+
+        for (size_t i = 0; i < 256; i++) {
+            unsigned long long z = (seed += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            values[i] = z ^ (z >> 31);
+        }
+    }
+} _s_gear;
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: public function member definitions
+//
+
+ContentChunker::ContentChunker(std::vector<ChunkList::Chunk>& chunkList)
+    : chunks(chunkList)
+    , fingerprint(0)
+    , chunk_length(0)
+{
+    chunks.clear();
+    MD5_Init(&context);
+}
+
+void ContentChunker::update(const unsigned char *data, size_t size)
+{
+    while (size) {
+        bool isFound = false;
+        size_t len = findBoundary(data, size, isFound);
+
+        MD5_Update(&context, data, len);
+        chunk_length += len;
+
+        if (isFound)
+            emit();
+
+        data += len;
+        size -= len;
+    }
+}
+
+void ContentChunker::finish()
+{
+    if (chunk_length)
+        emit();
+}
+
+void ContentChunker::reset()
+{
+    chunks.clear();
+
+    fingerprint = 0;
+    chunk_length = 0;
+    MD5_Init(&context);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: private function member definitions
+//
+
+size_t ContentChunker::findBoundary(const unsigned char *data, size_t size, bool& isFound)
+{
+    //The chunk can't be cut before the minimal size, so these bytes are not hashed
+    size_t i = (chunk_length < _s_minChunkSize) ? std::min(size, _s_minChunkSize - chunk_length) : 0;
+
+    //And it is cut at the maximal size anyway
+    const size_t end = std::min(size, _s_maxChunkSize - chunk_length);
+    const size_t avgEnd = (chunk_length < _s_avgChunkSize) ? std::min(end, _s_avgChunkSize - chunk_length) : 0;
+
+    unsigned long long hash = fingerprint;
+
+    //Stricter mask before the average size, the looser one after it
+    for (; i < avgEnd; i++) {
+        hash = (hash << 1) + _s_gear.values[data[i]];
+
+        if (!(hash & _s_maskSmall)) {
+            isFound = true;
+            return (i + 1);
+            //NOTREACHED
+        }
+    }
+
+    for (; i < end; i++) {
+        hash = (hash << 1) + _s_gear.values[data[i]];
+
+        if (!(hash & _s_maskLarge)) {
+            isFound = true;
+            return (i + 1);
+            //NOTREACHED
+        }
+    }
+
+    fingerprint = hash;
+    isFound = (chunk_length + end == _s_maxChunkSize);
+
+    return (end);
+}
+
+void ContentChunker::emit()
+{
+    unsigned char digest[MD5_DIGEST_LENGTH];
+    MD5_Final(digest, &context);
+
+    ChunkList::Chunk chunk;
+    chunk.digest = formatMD5(digest);
+    chunk.length = chunk_length;
+    chunks.push_back(chunk);
+
+    fingerprint = 0;
+    chunk_length = 0;
+    MD5_Init(&context);
+}
+
+//
+//
+//
@@ -0,0 +1,71 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// ContentChunker.h (V. Drozd)
+// src/modules/FileInfoLogger/src/ContentChunker.h
+//
+
+//
+// FastCDC chunker: the Gear rolling hash is checked against the stricter mask
+// before the average chunk size and against the looser one after it, so the
+// sizes are concentrated around the average
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include "CalculateSum/ChunkList.h"
+
+#include "openssl/md5.h"
+
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declarations
+//
+
+class ContentChunker {
+public:
+    //Chunks are appended to the list
+    ContentChunker(std::vector<ChunkList::Chunk>& chunkList);
+
+    //Data of the file in order, by pieces of any size
+    void update(const unsigned char *data, size_t size);
+
+    //The rest of the data is the last chunk
+    void finish();
+
+    //Drop the chunks, the file can't be read
+    void reset();
+private:
+    //deprecate copy constructor and assigment operator
+    ContentChunker(const ContentChunker&);
+    ContentChunker& operator=(const ContentChunker&);
+
+    //Bytes of data before the boundary of the current chunk (size if there is none)
+    size_t findBoundary(const unsigned char *data, size_t size, bool& isFound);
+    void   emit();
+
+
+    std::vector<ChunkList::Chunk>& chunks;
+
+    unsigned long long             fingerprint;
+    size_t                         chunk_length;
+    MD5_CTX                        context;
+};
+
+//
+//
+//
@@ -0,0 +1,608 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// DirectoryWalker.cpp    (V. Drozd)
+// src/modules/FileInfoLogger/src/DirectoryWalker.cpp
+//
+
+//
+// Lists regular files of the whole directory tree by several threads at once
+//
+
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "CalculateSum/DirectoryWalker.h"
+
+#include "FileInfoExtractor.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <errno.h>
+# include <dirent.h>
+# ifdef __linux__
+#  include <sys/syscall.h>
+# endif
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: variable definitions
+//
+
+//next() returns no more files at once, so the caller may start with them
+static const size_t _s_batchSize = 256;
+
+#ifdef __linux__
+//Large directories are read by a few calls (readdir() takes 32 KB at once)
+static const size_t _s_direntBufferSize = 128 * 1024;
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local declarations
+//
+
+#ifndef _WIN32
+//
+// Sort the entry of the directory dirFd by its type, entry is stat'ed relative
+// to the directory only if its type is unknown or it is a symbolic link, or if
+// its metadata is requested
+//
+
+static void _t_add_entry(int dirFd, const fs::path& dirPath, const char *name, unsigned char type,
+                         std::vector<fs::path>& files, std::vector<FileStat> *fileStats,
+                         std::vector<fs::path> *subdirs, std::vector<FileStat> *subdirStats);
+#endif
+
+//
+// Path of the entry relative to the root from the relative path of its directory
+//
+
+static std::string _t_rel_path(const std::string& dirRelPath, const fs::path& entryPath);
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: public function member definitions
+//
+
+DirectoryWalker::DirectoryWalker(const fs::path& rootDir)
+    : root_dir(rootDir)
+    , thread_count(0)
+    , is_file_stats(false)
+    , root_device(0)
+    , failed_count(0)
+{
+}
+
+DirectoryWalker::~DirectoryWalker()
+{
+    //Directories that are not started yet are not read
+    if (pool)
+        pool->clearTaskQueue();
+
+    pool.reset();
+}
+
+const fs::path& DirectoryWalker::rootDir() const
+{
+    return root_dir;
+}
+
+void DirectoryWalker::setThreadCount(size_t count)
+{
+    thread_count = count;
+}
+
+void DirectoryWalker::setFileFilter(const FileFilter& filter)
+{
+    file_filter = filter;
+}
+
+void DirectoryWalker::setFilterSpec(const FileFilterSpec& spec)
+{
+    filter_spec = spec;
+}
+
+void DirectoryWalker::setFileStats(bool enable)
+{
+    is_file_stats = enable;
+}
+
+bool DirectoryWalker::process()
+{
+    file_paths.clear();
+
+    if (!start()) {
+        return false;
+        //NOTREACHED
+    }
+
+    std::vector<fs::path> batch;
+    while (next(batch))
+        file_paths.insert(file_paths.end(), batch.begin(), batch.end());
+
+    return true;
+}
+
+const std::vector<fs::path>& DirectoryWalker::files() const
+{
+    return file_paths;
+}
+
+bool DirectoryWalker::start()
+{
+    if (pool)
+        pool->clearTaskQueue();
+
+    pool.reset();
+    frames.clear();
+    failed_count = 0;
+
+    boost::system::error_code ec;
+    fs::directory_iterator rootIt(root_dir, ec);
+    if (ec || !fs::is_directory(root_dir, ec)) {
+        return false;
+        //NOTREACHED
+    }
+
+#ifndef _WIN32
+    //Mounts are found by the device of the directory
+    if (filter_spec.isOneFileSystem()) {
+        FileStat rootStat;
+        if (!getFileStat(root_dir, rootStat, ec)) {
+            return false;
+            //NOTREACHED
+        }
+
+        root_device = rootStat.device;
+    }
+#endif
+
+    DirNodePtr root = std::make_shared<DirNode>();
+    root->path = root_dir;
+    root->depth = 0;
+    root->state = DIR_QUEUED;
+
+    Frame frame;
+    frame.node = root;
+    frame.pos = 0;
+    frames.push_back(frame);
+
+    size_t threads = thread_count ? thread_count : std::max(1U, std::thread::hardware_concurrency() - 1);
+    pool.reset(new ThreadPool(threads));
+
+    queueDirs(std::vector<DirNodePtr>(1, root));
+
+    return true;
+}
+
+bool DirectoryWalker::next(std::vector<fs::path>& files, bool wait)
+{
+    std::vector<FileStat> stats;
+    return next(files, stats, wait);
+}
+
+bool DirectoryWalker::next(std::vector<fs::path>& files, std::vector<FileStat>& stats, bool wait)
+{
+    files.clear();
+    stats.clear();
+
+    std::unique_lock<std::mutex> lock(walk_mutex);
+
+    while (!frames.empty() && files.size() < _s_batchSize) {
+        DirNode& node = *frames.back().node;
+
+        if (node.state != DIR_READY) {
+            //Files found so far are returned first, they can be hashed meanwhile
+            if (!files.empty() || !wait)
+                break;
+
+            //Directory is still in the queue, so it is read right here
+            if (node.state == DIR_QUEUED) {
+                node.state = DIR_READING;
+                lock.unlock();
+
+                readDir(node, false);
+
+                lock.lock();
+            }
+            else {
+                walk_cond.wait(lock);
+            }
+            continue;
+        }
+
+        Frame& frame = frames.back();
+
+        //Directory is finished, its listing is freed
+        if (frame.pos == node.entries.size()) {
+            frames.pop_back();
+            continue;
+        }
+
+        Entry& entry = node.entries[frame.pos++];
+
+        if (entry.dir) {
+            Frame child;
+            child.node.swap(entry.dir);
+            child.pos = 0;
+            frames.push_back(child);
+        }
+        else {
+            files.push_back(entry.path);
+            stats.push_back(entry.stat);
+        }
+    }
+
+    if (!frames.empty()) {
+        return true;
+        //NOTREACHED
+    }
+
+    lock.unlock();
+
+    //Every directory is read, the workers have nothing to do
+    pool.reset();
+
+    return !files.empty();
+}
+
+size_t DirectoryWalker::failedCount() const
+{
+    return failed_count;
+}
+
+bool DirectoryWalker::listDir(const fs::path& dirPath, std::vector<fs::path>& files,
+                              std::vector<fs::path> *subdirs, boost::system::error_code& ec)
+{
+    return listDir(dirPath, files, NULL, subdirs, NULL, ec);
+}
+
+bool DirectoryWalker::listDir(const fs::path& dirPath, std::vector<fs::path>& files, std::vector<FileStat> *fileStats,
+                              std::vector<fs::path> *subdirs, std::vector<FileStat> *subdirStats,
+                              boost::system::error_code& ec)
+{
+    ec.clear();
+
+#ifdef _WIN32
+    //Short names are not needed, and the entries are fetched by larger blocks
+    WIN32_FIND_DATAW data;
+    HANDLE find = FindFirstFileExW(
+        (dirPath / L"*").c_str(), FindExInfoBasic, &data,
+        FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH
+    );
+
+    if (INVALID_HANDLE_VALUE == find) {
+        ec.assign(GetLastError(), boost::system::system_category());
+        return false;
+        //NOTREACHED
+    }
+
+    do {
+        const std::wstring name(data.cFileName);
+        if (name == L"." || name == L"..")
+            continue;
+
+        const DWORD attributes = data.dwFileAttributes;
+        boost::system::error_code statEc;
+
+        //Link to the file is listed, link to the directory is not followed
+        if (attributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+            boost::system::error_code linkEc;
+
+            if (!(attributes & FILE_ATTRIBUTE_DIRECTORY) && fs::is_regular_file(dirPath / name, linkEc)) {
+                files.push_back(dirPath / name);
+
+                if (fileStats) {
+                    fileStats->push_back(FileStat());
+                    getFileStat(files.back(), fileStats->back(), statEc);
+                }
+            }
+        }
+        else if (attributes & FILE_ATTRIBUTE_DIRECTORY) {
+            if (subdirs) {
+                subdirs->push_back(dirPath / name);
+
+                if (subdirStats) {
+                    subdirStats->push_back(FileStat());
+                    getFileStat(subdirs->back(), subdirStats->back(), statEc);
+                }
+            }
+        }
+        else {
+            files.push_back(dirPath / name);
+
+            if (fileStats) {
+                fileStats->push_back(FileStat());
+                getFileStat(files.back(), fileStats->back(), statEc);
+            }
+        }
+    } while (FindNextFileW(find, &data));
+
+    DWORD error = GetLastError();
+    FindClose(find);
+
+    if (ERROR_NO_MORE_FILES != error)
+        ec.assign(error, boost::system::system_category());
+#else
+    int dirFd = ::open(dirPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) {
+        ec.assign(errno, boost::system::system_category());
+        return false;
+        //NOTREACHED
+    }
+
+# ifdef __linux__
+    //Layout of the records returned by getdents64()
+    struct LinuxDirent64 {
+        unsigned long long d_ino;
+        long long          d_off;
+        unsigned short     d_reclen;
+        unsigned char      d_type;
+        char               d_name[1];
+    };
+
+    std::unique_ptr<char[]> buffer(new char[_s_direntBufferSize]);
+
+    for (;;) {
+        long count = syscall(SYS_getdents64, dirFd, buffer.get(), _s_direntBufferSize);
+        if (count <= 0) {
+            if (count < 0)
+                ec.assign(errno, boost::system::system_category());
+            break;
+        }
+
+        for (long pos = 0; pos < count; ) {
+            const LinuxDirent64 *entry = reinterpret_cast<const LinuxDirent64 *>(buffer.get() + pos);
+            pos += entry->d_reclen;
+
+            _t_add_entry(dirFd, dirPath, entry->d_name, entry->d_type, files, fileStats, subdirs, subdirStats);
+        }
+    }
+
+    ::close(dirFd);
+# else
+    //Stream takes the descriptor, it is still used by fstatat()
+    DIR *dir = fdopendir(dirFd);
+    if (!dir) {
+        ec.assign(errno, boost::system::system_category());
+        ::close(dirFd);
+        return false;
+        //NOTREACHED
+    }
+
+    for (;;) {
+        errno = 0;
+        struct dirent *entry = readdir(dir);
+
+        if (!entry) {
+            if (errno)
+                ec.assign(errno, boost::system::system_category());
+            break;
+        }
+
+        _t_add_entry(dirFd, dirPath, entry->d_name, entry->d_type, files, fileStats, subdirs, subdirStats);
+    }
+
+    closedir(dir);
+# endif
+#endif
+
+    return !ec;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: private function member definitions
+//
+
+void DirectoryWalker::scanDir(DirNodePtr node)
+{
+    //The first subdirectory is read by this worker itself, the rest are queued for the others
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(walk_mutex);
+
+            //Taken by next() or by another worker
+            if (node->state != DIR_QUEUED)
+                break;
+
+            node->state = DIR_READING;
+        }
+
+        node = readDir(*node, true);
+        if (!node)
+            break;
+    }
+}
+
+DirectoryWalker::DirNodePtr DirectoryWalker::readDir(DirNode& node, bool keepFirst)
+{
+    std::vector<fs::path> files;
+    std::vector<fs::path> dirs;
+    boost::system::error_code ec;
+
+    const bool isRanged = filter_spec.hasMetadataRange();
+
+    //Metadata is taken relative to the directory while it is open (the devices of the
+    //subdirectories find the mounts), entries read before the error are still listed
+    std::vector<FileStat> fileStats;
+    std::vector<FileStat> dirStats;
+#ifdef _WIN32
+    //Mounted folders are reparse points, they are not listed anyway
+    const bool isOneFileSystem = false;
+#else
+    const bool isOneFileSystem = filter_spec.isOneFileSystem();
+#endif
+
+    listDir(node.path, files, (is_file_stats || isRanged) ? &fileStats : NULL,
+            &dirs, isOneFileSystem ? &dirStats : NULL, ec);
+
+    std::vector<Entry> entries;
+    entries.reserve(files.size() + dirs.size());
+
+    for (size_t i = 0; i < files.size(); i++) {
+        if (!filter_spec.isNameIncluded(_t_rel_path(node.rel_path, files[i])))
+            continue;
+
+        if (file_filter && !file_filter(files[i]))
+            continue;
+
+        Entry entry;
+        entry.path = files[i];
+
+        //Taken once for the ranges and for the caller, failed one is taken again by the caller
+        if (is_file_stats || isRanged) {
+            entry.stat = fileStats[i];
+
+            if (isRanged && !filter_spec.isStatIncluded(entry.stat))
+                continue;
+        }
+
+        entries.push_back(entry);
+    }
+
+    //Excluded subtrees are pruned here, before they are read
+    for (size_t i = 0; i < dirs.size(); i++) {
+        const std::string relPath = _t_rel_path(node.rel_path, dirs[i]);
+
+        if (!filter_spec.isDirIncluded(relPath, node.depth + 1))
+            continue;
+
+        if (isOneFileSystem && (!dirStats[i].is_valid || dirStats[i].device != root_device))
+            continue;
+
+        Entry entry;
+        entry.path = dirs[i];
+        entry.dir = std::make_shared<DirNode>();
+        entry.dir->path = dirs[i];
+        entry.dir->rel_path = relPath;
+        entry.dir->depth = node.depth + 1;
+        entry.dir->state = DIR_QUEUED;
+        entries.push_back(entry);
+    }
+
+    //Children of the directory go one after another in the order of the paths
+    std::sort(entries.begin(), entries.end(),
+        [](const Entry& a, const Entry& b) { return a.path < b.path; }
+    );
+
+    std::vector<DirNodePtr> subdirs;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].dir)
+            subdirs.push_back(entries[i].dir);
+    }
+
+    DirNodePtr retVal;
+    if (keepFirst && !subdirs.empty()) {
+        retVal = subdirs.front();
+        subdirs.erase(subdirs.begin());
+    }
+
+    //Queued before the node is ready, so next() can't finish the tree and stop the pool meanwhile
+    queueDirs(subdirs);
+
+    std::unique_lock<std::mutex> lock(walk_mutex);
+
+    if (ec)
+        failed_count++;
+
+    node.entries.swap(entries);
+    node.state = DIR_READY;
+    walk_cond.notify_all();
+
+    return (retVal);
+}
+
+void DirectoryWalker::queueDirs(const std::vector<DirNodePtr>& dirs)
+{
+    for (size_t i = 0; i < dirs.size(); i++) {
+        DirNodePtr dir = dirs[i];
+        pool->addTask([this, dir]() { scanDir(dir); });
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local definitions
+//
+
+#ifndef _WIN32
+static void _t_add_entry(int dirFd, const fs::path& dirPath, const char *name, unsigned char type,
+                         std::vector<fs::path>& files, std::vector<FileStat> *fileStats,
+                         std::vector<fs::path> *subdirs, std::vector<FileStat> *subdirStats)
+{
+    if (name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]))) {
+        return;
+        //NOTREACHED
+    }
+
+    //Some file systems (and NFS without READDIRPLUS) don't report the type
+    if (DT_UNKNOWN == type) {
+        struct stat st;
+        if (fstatat(dirFd, name, &st, AT_SYMLINK_NOFOLLOW)) {
+            return;
+            //NOTREACHED
+        }
+
+        type = S_ISDIR(st.st_mode) ? DT_DIR : (S_ISREG(st.st_mode) ? DT_REG : (S_ISLNK(st.st_mode) ? DT_LNK : DT_UNKNOWN));
+    }
+
+    //Link to the file is listed, link to the directory is not followed
+    if (DT_LNK == type) {
+        struct stat st;
+        if (fstatat(dirFd, name, &st, 0) || !S_ISREG(st.st_mode)) {
+            return;
+            //NOTREACHED
+        }
+
+        type = DT_REG;
+    }
+
+    boost::system::error_code ec;
+
+    if (DT_REG == type) {
+        files.push_back(dirPath / name);
+
+        if (fileStats) {
+            fileStats->push_back(FileStat());
+            getFileStatAt(dirFd, name, fileStats->back(), ec);
+        }
+    }
+    else if (DT_DIR == type && subdirs) {
+        subdirs->push_back(dirPath / name);
+
+        //Directory is not a link here, so its metadata is the same followed or not
+        if (subdirStats) {
+            subdirStats->push_back(FileStat());
+            getFileStatAt(dirFd, name, subdirStats->back(), ec);
+        }
+    }
+}
+#endif
+
+static std::string _t_rel_path(const std::string& dirRelPath, const fs::path& entryPath)
+{
+    const std::string name = entryPath.filename().string();
+    return dirRelPath.empty() ? name : dirRelPath + "/" + name;
+}
+
+//
+//
+//
@@ -0,0 +1,238 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// DuplicateFinder.cpp    (V. Drozd)
+// src/modules/FileInfoLogger/src/DuplicateFinder.cpp
+//
+
+//
+// Searches for files with the same content, reading as little as possible
+//
+
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "CalculateSum/DuplicateFinder.h"
+#include "FileInfoExtractor.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: variable definitions
+//
+
+static const size_t _s_defaultEdgeSize = 4096;
+
+//MD5 of the empty file, nothing to read
+static const char _s_emptyMD5[] = "d41d8cd98f00b204e9800998ecf8427e";
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: public function member definitions
+//
+
+DuplicateFinder::DuplicateFinder(const std::vector<fs::path>& filePaths)
+    : file_paths(filePaths)
+    , edge_size(_s_defaultEdgeSize)
+    , bytes_read(0)
+{
+    //The same order as in the log
+    std::sort(file_paths.begin(), file_paths.end());
+}
+
+void DuplicateFinder::setEdgeSize(size_t bytes)
+{
+    edge_size = std::max<size_t>(1, bytes);
+}
+
+bool DuplicateFinder::process()
+{
+    CandidateList candidates;
+
+    duplicate_groups.clear();
+    bytes_read = 0;
+
+    //Stage 1: files of the unique size can't have duplicates
+    groupBySize(candidates);
+    dropUnique(candidates);
+
+    //Create thread pool with optimal size for logger
+    ThreadPool pool(std::max(1U, std::thread::hardware_concurrency() - 1));
+
+    //Stage 2: head and tail are enough to tell most of the different files
+    hashCandidates(pool, candidates, false);
+    dropUnique(candidates);
+
+    //Stage 3: only real suspects are read completely
+    hashCandidates(pool, candidates, true);
+    dropUnique(candidates);
+
+    //Collect groups, candidates are sorted by size and checksum already
+    for (size_t i = 0; i < candidates.size(); i++) {
+        const Candidate& cur = candidates[i];
+
+        if (!i || cur.size != candidates[i - 1].size || cur.checksum != candidates[i - 1].checksum) {
+            DuplicateGroup group;
+            group.size = cur.size;
+            group.checksum = cur.checksum;
+            duplicate_groups.push_back(group);
+        }
+
+        duplicate_groups.back().paths.push_back(file_paths[cur.idx]);
+    }
+
+    return true;
+}
+
+const std::vector<DuplicateGroup>& DuplicateFinder::groups() const
+{
+    return duplicate_groups;
+}
+
+long long DuplicateFinder::bytesRead() const
+{
+    return bytes_read;
+}
+
+void DuplicateFinder::writeGroups(std::ostream& out) const
+{
+    for (size_t i = 0; i < duplicate_groups.size(); i++) {
+        const DuplicateGroup& group = duplicate_groups[i];
+
+        out << "MD5: " << group.checksum << ", size is: " << getHumanReadableSize(group.size)
+            << ", copies: " << group.paths.size() << "\n";
+
+        for (size_t j = 0; j < group.paths.size(); j++)
+            out << "\t" << group.paths[j].string() << "\n";
+
+        out << "\n";
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: private function member definitions
+//
+
+void DuplicateFinder::groupBySize(CandidateList& candidates)
+{
+    candidates.reserve(file_paths.size());
+
+    for (size_t i = 0; i < file_paths.size(); i++) {
+        boost::system::error_code ec;
+
+        //Directories and unreadable files can't be compared
+        if (!fs::is_regular_file(file_paths[i], ec))
+            continue;
+
+        auto size = fs::file_size(file_paths[i], ec);
+        if (ec)
+            continue;
+
+        Candidate candidate;
+        candidate.idx = i;
+        candidate.size = static_cast<long long>(size);
+
+        //All empty files are the same
+        if (!candidate.size)
+            candidate.checksum = _s_emptyMD5;
+
+        candidates.push_back(candidate);
+    }
+}
+
+void DuplicateFinder::hashCandidates(ThreadPool& pool, CandidateList& candidates, bool isFull)
+{
+    std::vector<std::future<std::string>> results(candidates.size());
+
+    for (size_t i = 0; i < candidates.size(); i++) {
+        Candidate& cur = candidates[i];
+
+        //Empty file, or small file that was read completely by the previous stage
+        if (!cur.size || (isFull && cur.size <= 2 * static_cast<long long>(edge_size)))
+            continue;
+
+        fs::path *cpath = &file_paths[cur.idx];
+        long long size = cur.size;
+        size_t edgeSize = edge_size;
+
+        results[i] = pool.addTask([this, cpath, size, edgeSize, isFull]() {
+            boost::system::error_code ec;
+            std::string checksum = isFull
+                ? getFileMD5(*cpath, ec)
+                : getFileEdgesMD5(*cpath, size, edgeSize, ec);
+
+            bytes_read += isFull ? size : std::min<long long>(size, 2 * edgeSize);
+
+            return ec ? std::string() : checksum;
+        });
+    }
+
+    for (size_t i = 0; i < candidates.size(); i++) {
+        if (!results[i].valid())
+            continue;
+
+        candidates[i].checksum = results[i].get();
+
+        //Unreadable file is dropped from the search
+        if (candidates[i].checksum.empty())
+            candidates[i].size = -1;
+    }
+}
+
+void DuplicateFinder::dropUnique(CandidateList& candidates)
+{
+    //Failed files have negative size and are dropped too
+    candidates.erase(
+        std::remove_if(
+            candidates.begin(),
+            candidates.end(),
+            [](const Candidate& cur) { return cur.size < 0; }
+        ),
+        candidates.end()
+    );
+
+    std::stable_sort(
+        candidates.begin(),
+        candidates.end(),
+        [](const Candidate& a, const Candidate& b) {
+            if (a.size != b.size)
+                return a.size > b.size;
+            return a.checksum < b.checksum;
+        }
+    );
+
+    CandidateList retVal;
+    retVal.reserve(candidates.size());
+
+    for (size_t i = 0; i < candidates.size(); ) {
+        size_t last = i + 1;
+        while (last < candidates.size() &&
+               candidates[last].size == candidates[i].size &&
+               candidates[last].checksum == candidates[i].checksum)
+            last++;
+
+        if (last - i > 1)
+            retVal.insert(retVal.end(), candidates.begin() + i, candidates.begin() + last);
+
+        i = last;
+    }
+
+    candidates.swap(retVal);
+}
+
+//
+//
+//
@@ -0,0 +1,380 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileFilterSpec.cpp    (V. Drozd)
+// src/modules/FileInfoLogger/src/FileFilterSpec.cpp
+//
+
+//
+// Include and exclude rules of the files and directories of the tree
+//
+
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "CalculateSum/FileFilterSpec.h"
+
+#include <limits>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local declarations
+//
+
+//
+// Match the string against the glob (see FileFilterSpec.h)
+//
+
+static bool _t_glob_match(const char *pattern, const char *str);
+
+//
+// Match one character against the class that follows '[', the end of the
+// class is returned in classEnd (NULL if the class isn't closed)
+//
+
+static bool _t_class_match(const char *pattern, char c, const char *& classEnd);
+
+//
+// Last component of the '/' separated path
+//
+
+static std::string _t_name_of(const std::string& relPath);
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: public function member definitions
+//
+
+FileFilterSpec::FileFilterSpec()
+    : min_size(0)
+    , max_size(std::numeric_limits<unsigned long long>::max())
+    , min_time(std::numeric_limits<std::time_t>::min())
+    , max_time(std::numeric_limits<std::time_t>::max())
+    , max_depth(0)
+    , is_one_file_system(false)
+{
+}
+
+void FileFilterSpec::addInclude(const std::string& pattern)
+{
+    include_files.add(pattern);
+}
+
+void FileFilterSpec::addExclude(const std::string& pattern)
+{
+    if (pattern.empty()) {
+        return;
+        //NOTREACHED
+    }
+
+    //"build/" is the directory only
+    if ('/' == pattern[pattern.size() - 1]) {
+        exclude_dirs.add(pattern.substr(0, pattern.size() - 1));
+        return;
+        //NOTREACHED
+    }
+
+    exclude_files.add(pattern);
+    exclude_dirs.add(pattern);
+}
+
+void FileFilterSpec::setSizeRange(unsigned long long minSize, unsigned long long maxSize)
+{
+    min_size = minSize;
+    max_size = maxSize;
+}
+
+void FileFilterSpec::setTimeRange(std::time_t minTime, std::time_t maxTime)
+{
+    min_time = minTime;
+    max_time = maxTime;
+}
+
+void FileFilterSpec::setMaxDepth(size_t depth)
+{
+    max_depth = depth;
+}
+
+size_t FileFilterSpec::maxDepth() const
+{
+    return max_depth;
+}
+
+void FileFilterSpec::setOneFileSystem(bool enable)
+{
+    is_one_file_system = enable;
+}
+
+bool FileFilterSpec::isOneFileSystem() const
+{
+    return is_one_file_system;
+}
+
+bool FileFilterSpec::isEmpty() const
+{
+    return include_files.empty() && exclude_files.empty() && exclude_dirs.empty() &&
+           !hasMetadataRange() && !max_depth && !is_one_file_system;
+}
+
+bool FileFilterSpec::hasMetadataRange() const
+{
+    return min_size || max_size != std::numeric_limits<unsigned long long>::max() ||
+           min_time != std::numeric_limits<std::time_t>::min() ||
+           max_time != std::numeric_limits<std::time_t>::max();
+}
+
+bool FileFilterSpec::isDirIncluded(const std::string& relPath, size_t depth) const
+{
+    if (max_depth && depth >= max_depth) {
+        return false;
+        //NOTREACHED
+    }
+
+    return relPath.empty() || !exclude_dirs.match(relPath);
+}
+
+bool FileFilterSpec::isNameIncluded(const std::string& relPath) const
+{
+    if (exclude_files.match(relPath)) {
+        return false;
+        //NOTREACHED
+    }
+
+    return include_files.empty() || include_files.match(relPath);
+}
+
+bool FileFilterSpec::isStatIncluded(const FileStat& stat) const
+{
+    return stat.is_valid &&
+           stat.size >= min_size && stat.size <= max_size &&
+           stat.mtime >= min_time && stat.mtime <= max_time;
+}
+
+bool FileFilterSpec::isPathIncluded(const std::string& relPath, const FileStat& stat) const
+{
+    //Every directory of the path from the root must be read
+    size_t depth = 0;
+    if (!isDirIncluded(std::string(), depth)) {
+        return false;
+        //NOTREACHED
+    }
+
+    for (size_t pos = relPath.find('/'); pos != std::string::npos; pos = relPath.find('/', pos + 1)) {
+        if (!isDirIncluded(relPath.substr(0, pos), ++depth)) {
+            return false;
+            //NOTREACHED
+        }
+    }
+
+    return isNameIncluded(relPath) && (!hasMetadataRange() || isStatIncluded(stat));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: private function member definitions
+//
+
+bool FileFilterSpec::GlobSet::empty() const
+{
+    return names.empty() && extensions.empty() && name_globs.empty() && path_globs.empty();
+}
+
+void FileFilterSpec::GlobSet::add(const std::string& pattern)
+{
+    if (pattern.empty()) {
+        return;
+        //NOTREACHED
+    }
+
+    //Path is relative to the root anyway
+    const std::string glob = ('/' == pattern[0]) ? pattern.substr(1) : pattern;
+
+    if (glob.find('/') != std::string::npos) {
+        path_globs.push_back(glob);
+        return;
+        //NOTREACHED
+    }
+
+    const size_t wildcard = glob.find_first_of("*?[");
+
+    if (std::string::npos == wildcard) {
+        names.insert(glob);
+    }
+    else if (glob.size() > 2 && '*' == glob[0] && '.' == glob[1] &&
+             glob.find_first_of("*?[.", 2) == std::string::npos) {
+        extensions.insert(glob.substr(1));
+    }
+    else {
+        name_globs.push_back(glob);
+    }
+}
+
+bool FileFilterSpec::GlobSet::match(const std::string& relPath) const
+{
+    const std::string name = _t_name_of(relPath);
+
+    if (!names.empty() && names.count(name)) {
+        return true;
+        //NOTREACHED
+    }
+
+    if (!extensions.empty()) {
+        const size_t dot = name.rfind('.');
+
+        if (dot != std::string::npos && extensions.count(name.substr(dot))) {
+            return true;
+            //NOTREACHED
+        }
+    }
+
+    for (size_t i = 0; i < name_globs.size(); i++) {
+        if (_t_glob_match(name_globs[i].c_str(), name.c_str())) {
+            return true;
+            //NOTREACHED
+        }
+    }
+
+    for (size_t i = 0; i < path_globs.size(); i++) {
+        if (_t_glob_match(path_globs[i].c_str(), relPath.c_str())) {
+            return true;
+            //NOTREACHED
+        }
+    }
+
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local definitions
+//
+
+static bool _t_glob_match(const char *pattern, const char *str)
+{
+    for (; *pattern; pattern++, str++) {
+        switch (*pattern) {
+        case '*':
+            if ('*' == pattern[1]) {
+                const char *rest = pattern + 2;
+
+                //"**/" matches no directory as well
+                if ('/' == *rest && _t_glob_match(rest + 1, str)) {
+                    return true;
+                    //NOTREACHED
+                }
+
+                for (;; str++) {
+                    if (_t_glob_match(rest, str)) {
+                        return true;
+                        //NOTREACHED
+                    }
+
+                    if (!*str)
+                        return false;
+                }
+            }
+
+            //One '*' stays within the component
+            for (;; str++) {
+                if (_t_glob_match(pattern + 1, str)) {
+                    return true;
+                    //NOTREACHED
+                }
+
+                if (!*str || '/' == *str)
+                    return false;
+            }
+
+        case '?':
+            if (!*str || '/' == *str) {
+                return false;
+                //NOTREACHED
+            }
+            break;
+
+        case '[': {
+            if (!*str || '/' == *str) {
+                return false;
+                //NOTREACHED
+            }
+
+            const char *classEnd = NULL;
+            bool isMatched = _t_class_match(pattern + 1, *str, classEnd);
+
+            //Not closed class is the literal '['
+            if (!classEnd) {
+                if (*str != '[')
+                    return false;
+                break;
+            }
+
+            if (!isMatched) {
+                return false;
+                //NOTREACHED
+            }
+
+            pattern = classEnd;
+            break;
+        }
+
+        default:
+            if (*pattern != *str) {
+                return false;
+                //NOTREACHED
+            }
+            break;
+        }
+    }
+
+    return !*str;
+}
+
+static bool _t_class_match(const char *pattern, char c, const char *& classEnd)
+{
+    bool isNegated = false;
+    if ('!' == *pattern || '^' == *pattern) {
+        isNegated = true;
+        pattern++;
+    }
+
+    bool isMatched = false;
+
+    //']' right after '[' is the member of the class
+    for (const char *p = pattern; *p; p++) {
+        if (']' == *p && p != pattern) {
+            classEnd = p;
+            return isMatched != isNegated;
+            //NOTREACHED
+        }
+
+        if ('-' == p[1] && p[2] && ']' != p[2]) {
+            if (c >= p[0] && c <= p[2])
+                isMatched = true;
+            p += 2;
+        }
+        else if (c == *p) {
+            isMatched = true;
+        }
+    }
+
+    classEnd = NULL;
+    return false;
+}
+
+static std::string _t_name_of(const std::string& relPath)
+{
+    const size_t slash = relPath.rfind('/');
+    return (std::string::npos == slash) ? relPath : relPath.substr(slash + 1);
+}
+
+//
+//
+//
@@ -0,0 +1,494 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileInfoDaemon.cpp    (V. Drozd)
+// src/modules/FileInfoLogger/src/FileInfoDaemon.cpp
+//
+
+//
+// Resident service that calculates file information on request
+// received over a local (unix domain) socket
+//
+
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "CalculateSum/FileInfoDaemon.h"
+#include "FileInfoExtractor.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+
+#ifdef _WIN32
+# include <winsock2.h>
+# pragma comment(lib, "ws2_32.lib")
+
+typedef SOCKET socket_type;
+# define _close_socket closesocket
+# define _SHUT_BOTH    SD_BOTH
+# define _SEND_FLAGS   0
+
+//afunix.h is shipped only with Windows 10 SDK (AF_UNIX works since 1803)
+struct sockaddr_un {
+    ADDRESS_FAMILY sun_family;
+    char           sun_path[108];
+};
+#else
+# include <sys/socket.h>
+# include <sys/select.h>
+# include <sys/stat.h>
+# include <sys/un.h>
+# include <unistd.h>
+# include <errno.h>
+
+typedef int socket_type;
+# define INVALID_SOCKET (-1)
+# define _close_socket  ::close
+# define _SHUT_BOTH     SHUT_RDWR
+# define _SEND_FLAGS    MSG_NOSIGNAL
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: variable definitions
+//
+
+//How often the waiting for clients is interrupted to check stop request
+static const long _s_stopCheckInterval = 1;
+
+static const size_t _s_defaultCacheLimit = 1024 * 1024;
+
+//Files modified during this time (seconds) are not cached, FAT keeps the time by 2 seconds
+static const std::time_t _s_racyInterval = 2;
+
+static const char _s_hashCmd[]   = "HASH ";
+static const char _s_verifyCmd[] = "VERIFY ";
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local declarations
+//
+
+//
+// Remove the socket left by the previous instance, false if the path is
+// taken by something else (e.g. the mistyped path of the regular file)
+//
+
+static bool _t_remove_socket(const fs::path& socketPath);
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: connection
+//
+
+struct FileInfoDaemon::Connection {
+    socket_type sock;
+    std::string buffer;
+
+    Connection(socket_type s)
+        : sock(s)
+    {
+    }
+
+    ~Connection()
+    {
+        _close_socket(sock);
+    }
+
+    //Wake up the thread that is blocked in readLine()
+    void shutdown()
+    {
+        ::shutdown(sock, _SHUT_BOTH);
+    }
+
+    //false on end of stream or error
+    bool readLine(std::string& line)
+    {
+        for (;;) {
+            auto pos = buffer.find('\n');
+            if (pos != std::string::npos) {
+                line.assign(buffer, 0, pos);
+                buffer.erase(0, pos + 1);
+
+                if (!line.empty() && line.back() == '\r')
+                    line.erase(line.end() - 1);
+                return true;
+                //NOTREACHED
+            }
+
+            char data[4096];
+            int len = recv(sock, data, sizeof(data), 0);
+            if (len <= 0)
+                break;
+
+            buffer.append(data, len);
+        }
+
+        //Last line can be not terminated
+        if (buffer.empty()) {
+            return false;
+            //NOTREACHED
+        }
+
+        line.swap(buffer);
+        buffer.clear();
+        return true;
+    }
+
+    bool write(const std::string& text)
+    {
+        const char *data = text.c_str();
+        size_t left = text.size();
+
+        while (left) {
+            int len = send(sock, data, static_cast<int>(left), _SEND_FLAGS);
+            if (len <= 0) {
+                return false;
+                //NOTREACHED
+            }
+
+            data += len;
+            left -= len;
+        }
+
+        return true;
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: public function member definitions
+//
+
+FileInfoDaemon::FileInfoDaemon(const fs::path& socketPath)
+    : socket_path(socketPath)
+    , cache_limit(_s_defaultCacheLimit)
+    , is_stopped(false)
+{
+}
+
+FileInfoDaemon::~FileInfoDaemon()
+{
+}
+
+void FileInfoDaemon::setCacheLimit(size_t entries)
+{
+    cache_limit = std::max<size_t>(1, entries);
+}
+
+bool FileInfoDaemon::run()
+{
+    sockaddr_un addr;
+    std::string sockName = socket_path.string();
+
+    if (sockName.size() >= sizeof(addr.sun_path)) {
+        return false;
+        //NOTREACHED
+    }
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData)) {
+        return false;
+        //NOTREACHED
+    }
+#endif
+
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, sockName.c_str());
+
+    //Socket file can be left by the previous instance
+    if (!_t_remove_socket(socket_path)) {
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return false;
+        //NOTREACHED
+    }
+
+    socket_type listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool status = (INVALID_SOCKET != listener);
+
+    if (status) {
+        //Other users must not read files by the rights of the daemon,
+        //the mode is taken from umask, so it is restricted for bind() only
+#ifndef _WIN32
+        mode_t prevMask = umask(0177);
+#endif
+        status = !bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+#ifndef _WIN32
+        umask(prevMask);
+#endif
+        status = status && !listen(listener, SOMAXCONN);
+    }
+
+    //Warm workers are shared by all clients
+    if (status)
+        pool.reset(new ThreadPool(std::max(1U, std::thread::hardware_concurrency() - 1)));
+
+    while (status && !is_stopped) {
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(listener, &readSet);
+
+        timeval timeout = { _s_stopCheckInterval, 0 };
+
+        int rc = select(static_cast<int>(listener) + 1, &readSet, NULL, NULL, &timeout);
+        if (rc <= 0) {
+#ifndef _WIN32
+            if (rc < 0 && EINTR != errno)
+                status = false;
+#else
+            if (rc < 0)
+                status = false;
+#endif
+            continue;
+        }
+
+        socket_type sock = accept(listener, NULL, NULL);
+        if (INVALID_SOCKET == sock)
+            continue;
+
+        auto client = std::make_shared<Connection>(sock);
+        {
+            std::unique_lock<std::mutex> lock(clients_mutex);
+            clients.insert(client);
+        }
+
+        std::thread(&FileInfoDaemon::serveClient, this, client).detach();
+    }
+
+    //Disconnect all clients and wait for their threads
+    {
+        std::unique_lock<std::mutex> lock(clients_mutex);
+
+        for (auto it = clients.begin(); it != clients.end(); ++it)
+            (*it)->shutdown();
+
+        while (!clients.empty())
+            clients_done_condition.wait(lock);
+    }
+
+    pool.reset();
+
+    if (INVALID_SOCKET != listener)
+        _close_socket(listener);
+
+    _t_remove_socket(socket_path);
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+
+    return (status);
+}
+
+void FileInfoDaemon::stop()
+{
+    is_stopped = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: private function member definitions
+//
+
+void FileInfoDaemon::serveClient(std::shared_ptr<Connection> client)
+{
+    bool isOpen = true;
+
+    while (isOpen && !is_stopped) {
+        std::vector<std::future<std::string>> answers;
+        std::string line;
+
+        //Collect the batch and start calculation at once
+        while ((isOpen = client->readLine(line)) && !line.empty()) {
+            answers.push_back(pool->addTask(
+                [this, line]() { return processRequest(line); }
+            ));
+        }
+
+        if (answers.empty())
+            continue;
+
+        //Answers are streamed back in the order of requests
+        for (size_t i = 0; i < answers.size(); i++) {
+            if (!client->write(answers[i].get() + "\n")) {
+                isOpen = false;
+                break;
+            }
+        }
+
+        if (isOpen)
+            isOpen = client->write("\n");
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(clients_mutex);
+        clients.erase(client);
+        clients_done_condition.notify_all();
+    }
+}
+
+std::string FileInfoDaemon::processRequest(const std::string& request)
+{
+    static const size_t hashCmdLen   = sizeof(_s_hashCmd) - 1;
+    static const size_t verifyCmdLen = sizeof(_s_verifyCmd) - 1;
+
+    std::string pathName;
+    std::string expected;
+    bool isVerify = false;
+
+    if (!request.compare(0, hashCmdLen, _s_hashCmd)) {
+        pathName = request.substr(hashCmdLen);
+    }
+    else if (!request.compare(0, verifyCmdLen, _s_verifyCmd)) {
+        auto pos = request.find(' ', verifyCmdLen);
+        if (pos == std::string::npos) {
+            return "ERROR " + request;
+            //NOTREACHED
+        }
+
+        expected = request.substr(verifyCmdLen, pos - verifyCmdLen);
+        std::transform(expected.begin(), expected.end(), expected.begin(), ::tolower);
+
+        pathName = request.substr(pos + 1);
+        isVerify = true;
+    }
+    else {
+        return "ERROR " + request;
+        //NOTREACHED
+    }
+
+    fs::path fpath(pathName);
+    FileInfo finfo = getFileInfo(fpath);
+
+    if (!finfo.is_correct) {
+        return "ERROR " + pathName;
+        //NOTREACHED
+    }
+
+    if (!isVerify) {
+        return "OK " + finfo.checksum + " " + std::to_string(finfo.size) + " " + pathName;
+        //NOTREACHED
+    }
+
+    if (expected == finfo.checksum) {
+        return "MATCH " + pathName;
+        //NOTREACHED
+    }
+
+    return "MISMATCH " + finfo.checksum + " " + pathName;
+}
+
+FileInfo FileInfoDaemon::getFileInfo(fs::path& fpath)
+{
+    FileInfo finfo;
+    boost::system::error_code ec;
+
+    finfo.is_correct = false;
+
+    //Taken before hashing, so a file changed during it is rehashed next time
+    FileStat stat;
+    if (!getFileStat(fpath, stat, ec) || stat.is_directory) {
+        return finfo;
+        //NOTREACHED
+    }
+
+    const std::string key = fpath.string();
+
+    {
+        std::unique_lock<std::mutex> lock(cache_mutex);
+
+        //Rewritten file has the other times or the other inode (if it was replaced)
+        auto finded = cache.find(key);
+        if (finded != cache.end()) {
+            const FileStat& cached = finded->second.stat;
+
+            if (cached.size == stat.size && cached.mtime_ns == stat.mtime_ns && cached.ctime_ns == stat.ctime_ns &&
+                cached.inode == stat.inode && cached.device == stat.device) {
+                return finded->second.info;
+                //NOTREACHED
+            }
+        }
+    }
+
+    finfo = FileInfoExtract(fpath, NULL, 0, NULL, NULL, NULL, &stat);
+    if (!finfo.is_correct) {
+        return finfo;
+        //NOTREACHED
+    }
+
+    //The next write in the same tick of the file system clock isn't seen by the times
+    if (stat.mtime >= std::time(NULL) - _s_racyInterval) {
+        return finfo;
+        //NOTREACHED
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(cache_mutex);
+
+        //Simple bound of the memory usage, the cache is warmed up again quickly
+        if (cache.size() >= cache_limit)
+            cache.clear();
+
+        CacheEntry entry = { stat, finfo };
+        cache[key] = entry;
+    }
+
+    return finfo;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local definitions
+//
+
+static bool _t_remove_socket(const fs::path& socketPath)
+{
+#ifdef _WIN32
+    //Socket is the reparse point of its own tag
+    WIN32_FIND_DATAW findData;
+    HANDLE find = FindFirstFileW(socketPath.c_str(), &findData);
+    if (INVALID_HANDLE_VALUE == find) {
+        return (ERROR_FILE_NOT_FOUND == GetLastError() || ERROR_PATH_NOT_FOUND == GetLastError());
+        //NOTREACHED
+    }
+    FindClose(find);
+
+    const DWORD afUnixTag = 0x80000023;  //IO_REPARSE_TAG_AF_UNIX
+    if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) || findData.dwReserved0 != afUnixTag) {
+        return false;
+        //NOTREACHED
+    }
+
+    return DeleteFileW(socketPath.c_str()) != FALSE;
+#else
+    struct stat st;
+    if (lstat(socketPath.c_str(), &st)) {
+        return (ENOENT == errno);
+        //NOTREACHED
+    }
+
+    if (!S_ISSOCK(st.st_mode)) {
+        return false;
+        //NOTREACHED
+    }
+
+    return !unlink(socketPath.c_str()) || ENOENT == errno;
+#endif
+}
+
+//
+//
+//
@@ -0,0 +1,169 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileInfoDiff.cpp    (V. Drozd)
+// src/modules/FileInfoLogger/src/FileInfoDiff.cpp
+//
+
+//
+// Differences between two logs made by FileInfoLogger
+//
+
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "CalculateSum/FileInfoDiff.h"
+#include "LogReader.h"
+
+#include <fstream>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: public function member definitions
+//
+
+FileInfoDiff::FileInfoDiff(const fs::path& oldLogPath, const fs::path& newLogPath)
+    : old_log_path(oldLogPath)
+    , new_log_path(newLogPath)
+    , added_count(0)
+    , removed_count(0)
+    , modified_count(0)
+    , unchanged_count(0)
+{
+}
+
+bool FileInfoDiff::process(std::ostream& report)
+{
+    added_count = removed_count = modified_count = unchanged_count = 0;
+
+    LogReader oldFile;
+    LogReader newFile;
+
+    if (!oldFile.open(old_log_path) || !newFile.open(new_log_path)) {
+        return false;
+        //NOTREACHED
+    }
+
+    Cursor oldCursor = { &oldFile, FileInfo(), fs::path(), false, false };
+    Cursor newCursor = { &newFile, FileInfo(), fs::path(), false, false };
+
+    advance(oldCursor);
+    advance(newCursor);
+
+    while (oldCursor.is_valid || newCursor.is_valid) {
+        //Names are compared as paths, the same as the logger sorts them
+        int rc = !oldCursor.is_valid ? 1 : (!newCursor.is_valid ? -1 : oldCursor.name.compare(newCursor.name));
+
+        if (rc < 0) {
+            report << "REMOVED " << oldCursor.info.short_name << "\n";
+            removed_count++;
+        }
+        else if (rc > 0) {
+            report << "ADDED " << newCursor.info.short_name << "\n";
+            added_count++;
+        }
+        else if (isModified(oldCursor.info, newCursor.info)) {
+            report << "MODIFIED " << newCursor.info.short_name << "\n";
+            modified_count++;
+        }
+        else {
+            unchanged_count++;
+        }
+
+        if (rc <= 0)
+            advance(oldCursor);
+        if (rc >= 0)
+            advance(newCursor);
+    }
+
+    report.flush();
+
+    return (!oldCursor.is_broken && !newCursor.is_broken);
+}
+
+size_t FileInfoDiff::addedCount() const
+{
+    return added_count;
+}
+
+size_t FileInfoDiff::removedCount() const
+{
+    return removed_count;
+}
+
+size_t FileInfoDiff::modifiedCount() const
+{
+    return modified_count;
+}
+
+size_t FileInfoDiff::unchangedCount() const
+{
+    return unchanged_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: private function member definitions
+//
+
+void FileInfoDiff::advance(Cursor& cursor)
+{
+    std::string line;
+
+    if (cursor.is_broken || !cursor.in->getline(line)) {
+        cursor.is_valid = false;
+        cursor.is_broken = cursor.is_broken || cursor.in->is_broken();
+        return;
+        //NOTREACHED
+    }
+
+    FileInfo finfo;
+    fs::path name;
+
+    if (finfo.fromString(line))
+        name = finfo.short_name;
+
+    //Merge of the unsorted log would report nonsense, so it is stopped
+    if (name.empty() || (cursor.is_valid && name.compare(cursor.name) <= 0)) {
+        cursor.is_valid = false;
+        cursor.is_broken = true;
+        return;
+        //NOTREACHED
+    }
+
+    cursor.info = finfo;
+    cursor.name.swap(name);
+    cursor.is_valid = true;
+}
+
+bool FileInfoDiff::isModified(const FileInfo& oldInfo, const FileInfo& newInfo)
+{
+    if (oldInfo.is_correct != newInfo.is_correct) {
+        return true;
+        //NOTREACHED
+    }
+
+    if (!oldInfo.is_correct) {
+        return (oldInfo.error_code != newInfo.error_code);
+        //NOTREACHED
+    }
+
+    //Digests of the different types can't be compared, so the file is reported
+    return (oldInfo.digest_type != newInfo.digest_type ||
+            oldInfo.checksum != newInfo.checksum ||
+            oldInfo.human_readable_size != newInfo.human_readable_size);
+}
+
+//
+//
+//
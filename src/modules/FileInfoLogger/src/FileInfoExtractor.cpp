@@ -1,186 +1,718 @@
-//
-// -*- Mode: c++; tab-width: 4; -*-
-// -*- ex: ts=4 -*-
-//
-
-//
-// FileInfoExtractor.cpp (V. Drozd)
-// src/modules/FileInfoLogger/src/FileInfoExtractor.cpp
-//
-
-//
-// Provides functionality to get main information about the file
-//
-
-//
-// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
-// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
-// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
-//
-
-///////////////////////////////////////////////////////////////////////////////
-// %% BeginSection: includes
-//
-
-#define _CRT_SECURE_NO_WARNINGS
-
-#include "FileInfoExtractor.h"
-#include "openssl/md5.h"
-
-#include <ctime>
-#include <fstream>
-#include <iomanip>
-
-///////////////////////////////////////////////////////////////////////////////
-// %% BeginSection: local function declaration
-//
-
-std::string getTimeCreation(fs::path&, boost::system::error_code&);
-std::string getFileMD5(fs::path&);
-std::string getHumanReadableSize(long long);
-std::string byteToHexStr(unsigned char);
-
-///////////////////////////////////////////////////////////////////////////////
-// %% BeginSection: definitions
-//
-
-#define _array_size(arr) sizeof(arr) / sizeof(arr[0])
-
-FileInfo FileInfoExtract(fs::path& filePath)
-{
-    FileInfo finfo;
-    boost::system::error_code ec;
-    
-    finfo.is_correct = false;
-
-    do {
-		finfo.full_name = filePath.string();
-		finfo.short_name = filePath.filename().string();
-
-        finfo.size = fs::file_size(filePath, ec);
-        if (ec) {
-            break;
-            //NOTREACHED
-        }
-
-        finfo.creation = getTimeCreation(filePath, ec);
-        if (ec) {
-            break;
-            //NOTREACHED
-        }
-
-        finfo.checksum = getFileMD5(filePath);
-        if (finfo.checksum.empty()) {
-            break;
-            //NOTREACHED
-        }
-        
-        finfo.human_readable_size = getHumanReadableSize(finfo.size);
-
-        finfo.is_correct = true;
-
-    } while (0);
-
-    return (finfo);
-}
-
-///////////////////////////////////////////////////////////////////////////////
-// %% BeginSection: local function definitions
-//
-
-std::string getTimeCreation(fs::path& filePath, boost::system::error_code& ec)
-{
-    std::string retVal;
-
-    std::time_t time;
-    std::tm *tminfo;
-
-    time = fs::last_write_time(filePath, ec);
-    if (!!ec) {
-        return retVal;
-        //NOTREACHED
-    }
-
-    tminfo = std::localtime(&time);
-
-    retVal += std::to_string(tminfo->tm_mday) + "/";
-    retVal += std::to_string(tminfo->tm_mon + 1) + "/";
-    retVal += std::to_string(tminfo->tm_year + 1900);
-
-    return (retVal);
-}
-
-std::string getFileMD5(fs::path& filePath)
-{
-    std::string retVal;
-
-    static const int BUF_SIZE = 4096;
-    unsigned char data[BUF_SIZE];
-    unsigned char MD5res[MD5_DIGEST_LENGTH];
-
-    std::ifstream file(filePath.c_str(), std::ios::binary);
-
-    if (!file.is_open()) {
-        return retVal;
-        /*NOTREACHED*/
-    }
-
-    MD5_CTX mdContext;
-    MD5_Init(&mdContext);
-
-    while (file.read((char *)data, BUF_SIZE))
-        MD5_Update(&mdContext, data, BUF_SIZE);
-
-    MD5_Update(&mdContext, data, file.gcount());
-    MD5_Final(MD5res, &mdContext);
-
-    file.close();
-
-    for (size_t i = 0; i < MD5_DIGEST_LENGTH; i++)
-        retVal += byteToHexStr(MD5res[i]);
-
-    return (retVal);
-}
-
-std::string getHumanReadableSize(long long fileSize)
-{
-    static const auto _SIZE_TB = 1024LL * 1024LL * 1024LL * 1024LL;
-    static const char *sizesPrefix[] = { " Tera ", " Giga ", " Mega ", " Kilo ", " " };
-
-    if (!fileSize) {
-        return std::string("0 bytes");
-        //NOTREACHED
-    }
-
-    std::string retVal;
-
-    long long curSize;
-    long long delim = _SIZE_TB;
-
-    for (size_t i = 0; i < _array_size(sizesPrefix); i++, delim /= 1024LL) {
-        curSize = fileSize / delim;
-        fileSize %= delim;
-        
-        if (curSize) {
-            retVal += std::to_string(curSize) + sizesPrefix[i];
-            retVal += (1 == curSize) ? "byte " : "bytes ";
-        }
-    }
-    //Remove last space symbol
-    retVal.erase(retVal.end() - 1);
-
-    return (retVal);
-}
-
-std::string byteToHexStr(unsigned char ch)
-{
-    std::string retVal(2, 0);
-
-    std::sprintf(&retVal[0], "%02x", ch);
-
-    return (retVal);
-}
-
-//
-//
-//
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileInfoExtractor.cpp (V. Drozd)
+// src/modules/FileInfoLogger/src/FileInfoExtractor.cpp
+//
+
+//
+// Provides functionality to get main information about the file
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "FileInfoExtractor.h"
+#include "ContentChunker.h"
+#include "openssl/md5.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <sys/stat.h>
+# include <fcntl.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local function declaration
+//
+
+std::string byteToHexStr(unsigned char);
+void updateBlockMD5(MD5_CTX&, size_t&, size_t, const unsigned char *, size_t, std::vector<std::string>&);
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: definitions
+//
+
+#define _array_size(arr) sizeof(arr) / sizeof(arr[0])
+
+FileRecord FileRecordExtract(fs::path& filePath, ExtractProgress *progress,
+                             size_t blockSize, std::vector<std::string> *blockDigests,
+                             ContentChunker *chunker, const FingerprintSpec *fingerprint,
+                             const FileStat *stat)
+{
+    FileRecord record;
+    boost::system::error_code ec;
+    FileStat fileStat;
+
+    //Stat calls can hang as well as reads, so the watch starts here
+    if (progress)
+        progress->last_activity = steadyTicks();
+
+    do {
+        record.path = &filePath;
+
+        //Snapshot of the caller is reused, the file isn't stat'ed once more
+        if (stat && stat->is_valid)
+            fileStat = *stat;
+        else if (!getFileStat(filePath, fileStat, ec))
+            break;
+
+        if (fileStat.is_directory) {
+            ec.assign(EISDIR, boost::system::generic_category());
+            break;
+            /*NOTREACHED*/
+        }
+
+        record.size = fileStat.size;
+        record.creation_time = static_cast<long long>(fileStat.birth_time);
+
+        if (fingerprint)
+            getFileFingerprint(filePath, static_cast<long long>(record.size), *fingerprint, record.digest, ec, progress);
+        else
+            getFileMD5(filePath, record.digest, ec, progress, blockSize, blockDigests, chunker);
+
+        if (ec) {
+            break;
+            /*NOTREACHED*/
+        }
+
+        //Digest of the single block is the same as of the whole file
+        if (blockDigests && (blockDigests->size() < 2 || fingerprint))
+            blockDigests->clear();
+
+        record.is_correct = true;
+
+    } while (0);
+
+    if (ec) {
+        if (blockDigests)
+            blockDigests->clear();
+        if (chunker)
+            chunker->reset();
+
+        record.error_code = ec.value();
+        record.error_category = &ec.category();
+    }
+
+    return (record);
+}
+
+FileInfo FileInfoExtract(fs::path& filePath, ExtractProgress *progress,
+                         size_t blockSize, std::vector<std::string> *blockDigests,
+                         ContentChunker *chunker, const FingerprintSpec *fingerprint,
+                         const FileStat *stat)
+{
+    FileRecord record = FileRecordExtract(filePath, progress, blockSize, blockDigests, chunker, fingerprint, stat);
+
+    //Label lives until the text is made
+    const std::string label = fingerprint ? fingerprint->label() : std::string();
+    if (fingerprint)
+        record.digest_type = &label;
+
+    return record.toFileInfo();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local function definitions
+//
+
+std::string formatTimeCreation(std::time_t time)
+{
+    std::string retVal;
+
+    std::tm *tminfo = std::localtime(&time);
+
+    retVal += std::to_string(tminfo->tm_mday) + "/";
+    retVal += std::to_string(tminfo->tm_mon + 1) + "/";
+    retVal += std::to_string(tminfo->tm_year + 1900);
+
+    return (retVal);
+}
+
+std::string getFileMD5(fs::path& filePath, boost::system::error_code& ec, ExtractProgress *progress,
+                       size_t blockSize, std::vector<std::string> *blockDigests,
+                       ContentChunker *chunker)
+{
+    unsigned char MD5res[MD5_DIGEST_LENGTH];
+
+    if (!getFileMD5(filePath, MD5res, ec, progress, blockSize, blockDigests, chunker)) {
+        return std::string();
+        /*NOTREACHED*/
+    }
+
+    return formatMD5(MD5res);
+}
+
+bool getFileMD5(fs::path& filePath, unsigned char *digest, boost::system::error_code& ec,
+                ExtractProgress *progress, size_t blockSize, std::vector<std::string> *blockDigests,
+                ContentChunker *chunker)
+{
+    static const int BUF_SIZE = 4096;
+    unsigned char data[BUF_SIZE];
+
+    errno = 0;
+    std::ifstream file(filePath.c_str(), std::ios::binary);
+
+    if (!file.is_open()) {
+        ec.assign(errno ? errno : EACCES, boost::system::generic_category());
+        return false;
+        /*NOTREACHED*/
+    }
+
+    MD5_CTX mdContext;
+    MD5_Init(&mdContext);
+
+    //Digest of the current block and its filled size
+    MD5_CTX blockContext;
+    size_t blockFill = 0;
+
+    if (blockDigests) {
+        blockDigests->clear();
+        MD5_Init(&blockContext);
+    }
+
+    while (file.read((char *)data, BUF_SIZE)) {
+        MD5_Update(&mdContext, data, BUF_SIZE);
+
+        if (blockDigests)
+            updateBlockMD5(blockContext, blockFill, blockSize, data, BUF_SIZE, *blockDigests);
+
+        if (chunker)
+            chunker->update(data, BUF_SIZE);
+
+        if (progress) {
+            long long now = steadyTicks();
+            progress->last_activity.store(now, std::memory_order_relaxed);
+
+            if (progress->deadline && now > progress->deadline) {
+                ec.assign(ETIMEDOUT, boost::system::generic_category());
+                return false;
+                /*NOTREACHED*/
+            }
+        }
+    }
+
+    //Failed not because of the end of file
+    if (file.bad()) {
+        ec.assign(EIO, boost::system::generic_category());
+        return false;
+        /*NOTREACHED*/
+    }
+
+    MD5_Update(&mdContext, data, file.gcount());
+    MD5_Final(digest, &mdContext);
+
+    if (blockDigests) {
+        updateBlockMD5(blockContext, blockFill, blockSize, data, static_cast<size_t>(file.gcount()), *blockDigests);
+
+        //The last block is shorter
+        if (blockFill) {
+            unsigned char blockRes[MD5_DIGEST_LENGTH];
+            MD5_Final(blockRes, &blockContext);
+            blockDigests->push_back(formatMD5(blockRes));
+        }
+    }
+
+    if (chunker) {
+        chunker->update(data, static_cast<size_t>(file.gcount()));
+        chunker->finish();
+    }
+
+    file.close();
+
+    return true;
+}
+
+std::string getFileEdgesMD5(fs::path& filePath, long long fileSize, size_t edgeSize, boost::system::error_code& ec)
+{
+    std::string retVal;
+
+    unsigned char MD5res[MD5_DIGEST_LENGTH];
+    std::vector<char> data(std::max<size_t>(1, edgeSize));
+
+    errno = 0;
+    std::ifstream file(filePath.c_str(), std::ios::binary);
+
+    if (!file.is_open()) {
+        ec.assign(errno ? errno : EACCES, boost::system::generic_category());
+        return retVal;
+        /*NOTREACHED*/
+    }
+
+    MD5_CTX mdContext;
+    MD5_Init(&mdContext);
+
+    //Head of the file
+    std::streamsize len = static_cast<std::streamsize>(std::min<long long>(fileSize, edgeSize));
+
+    if (!file.read(&data[0], len)) {
+        ec.assign(EIO, boost::system::generic_category());
+        return retVal;
+        /*NOTREACHED*/
+    }
+    MD5_Update(&mdContext, &data[0], static_cast<size_t>(len));
+
+    //And its tail, without the bytes that are already in the head
+    if (fileSize > static_cast<long long>(edgeSize)) {
+        long long tailPos = std::max<long long>(fileSize - edgeSize, edgeSize);
+        len = static_cast<std::streamsize>(fileSize - tailPos);
+
+        if (len && (!file.seekg(tailPos) || !file.read(&data[0], len))) {
+            ec.assign(EIO, boost::system::generic_category());
+            return retVal;
+            /*NOTREACHED*/
+        }
+        MD5_Update(&mdContext, &data[0], static_cast<size_t>(len));
+    }
+
+    MD5_Final(MD5res, &mdContext);
+
+    file.close();
+
+    return formatMD5(MD5res);
+}
+
+std::string getFileFingerprint(fs::path& filePath, long long fileSize, const FingerprintSpec& spec,
+                               boost::system::error_code& ec, ExtractProgress *progress)
+{
+    unsigned char MD5res[MD5_DIGEST_LENGTH];
+
+    if (!getFileFingerprint(filePath, fileSize, spec, MD5res, ec, progress)) {
+        return std::string();
+        /*NOTREACHED*/
+    }
+
+    return formatMD5(MD5res);
+}
+
+bool getFileFingerprint(fs::path& filePath, long long fileSize, const FingerprintSpec& spec,
+                        unsigned char *digest, boost::system::error_code& ec, ExtractProgress *progress)
+{
+    errno = 0;
+    std::ifstream file(filePath.c_str(), std::ios::binary);
+
+    if (!file.is_open()) {
+        ec.assign(errno ? errno : EACCES, boost::system::generic_category());
+        return false;
+        /*NOTREACHED*/
+    }
+
+    //Ranges of the file to read: offset and length
+    std::vector<std::pair<long long, long long>> ranges;
+
+    //Parameters may come from the manifest, the sizes must not overflow
+    if (!spec.isValid()) {
+        ec.assign(EINVAL, boost::system::generic_category());
+        return false;
+        /*NOTREACHED*/
+    }
+
+    const long long sampled = spec.sampledSize();
+
+    if (fileSize <= sampled) {
+        ranges.push_back(std::make_pair(0LL, fileSize));
+    }
+    else {
+        const long long head = static_cast<long long>(spec.head_size);
+        const long long tail = static_cast<long long>(spec.tail_size);
+        const long long sample = static_cast<long long>(spec.sample_size);
+
+        //Samples are evenly spaced between the head and the tail
+        const long long step = (fileSize - head - tail - sample) / (static_cast<long long>(spec.sample_count) + 1);
+
+        ranges.push_back(std::make_pair(0LL, head));
+        for (size_t i = 1; i <= spec.sample_count; i++)
+            ranges.push_back(std::make_pair(head + step * static_cast<long long>(i), sample));
+        ranges.push_back(std::make_pair(fileSize - tail, tail));
+    }
+
+    MD5_CTX mdContext;
+    MD5_Init(&mdContext);
+
+    //The size is a part of the fingerprint
+    const std::string sizeText = std::to_string(fileSize) + "\n";
+    MD5_Update(&mdContext, sizeText.data(), sizeText.size());
+
+    static const size_t BUF_SIZE = 64 * 1024;
+    std::vector<char> data(BUF_SIZE);
+
+    for (size_t i = 0; i < ranges.size(); i++) {
+        long long left = ranges[i].second;
+
+        if (left && !file.seekg(ranges[i].first)) {
+            ec.assign(EIO, boost::system::generic_category());
+            return false;
+            /*NOTREACHED*/
+        }
+
+        while (left) {
+            std::streamsize len = static_cast<std::streamsize>(std::min<long long>(left, BUF_SIZE));
+
+            //File is shorter than it was, so it is being changed
+            if (!file.read(&data[0], len)) {
+                ec.assign(EIO, boost::system::generic_category());
+                return false;
+                /*NOTREACHED*/
+            }
+
+            MD5_Update(&mdContext, &data[0], static_cast<size_t>(len));
+            left -= len;
+
+            if (progress) {
+                long long now = steadyTicks();
+                progress->last_activity.store(now, std::memory_order_relaxed);
+
+                if (progress->deadline && now > progress->deadline) {
+                    ec.assign(ETIMEDOUT, boost::system::generic_category());
+                    return false;
+                    /*NOTREACHED*/
+                }
+            }
+        }
+    }
+
+    MD5_Final(digest, &mdContext);
+
+    return true;
+}
+
+std::string getFileRangeMD5(const fs::path& filePath, long long offset, size_t length, boost::system::error_code& ec)
+{
+    std::string retVal;
+
+    static const size_t BUF_SIZE = 64 * 1024;
+    std::vector<char> data(BUF_SIZE);
+    unsigned char MD5res[MD5_DIGEST_LENGTH];
+
+    errno = 0;
+    std::ifstream file(filePath.c_str(), std::ios::binary);
+
+    if (!file.is_open()) {
+        ec.assign(errno ? errno : EACCES, boost::system::generic_category());
+        return retVal;
+        /*NOTREACHED*/
+    }
+
+    if (!file.seekg(offset)) {
+        ec.assign(EIO, boost::system::generic_category());
+        return retVal;
+        /*NOTREACHED*/
+    }
+
+    MD5_CTX mdContext;
+    MD5_Init(&mdContext);
+
+    while (length) {
+        std::streamsize len = static_cast<std::streamsize>(std::min(length, BUF_SIZE));
+
+        file.read(&data[0], len);
+        MD5_Update(&mdContext, &data[0], static_cast<size_t>(file.gcount()));
+
+        if (file.gcount() < len)
+            break;
+
+        length -= static_cast<size_t>(len);
+    }
+
+    if (file.bad()) {
+        ec.assign(EIO, boost::system::generic_category());
+        return retVal;
+        /*NOTREACHED*/
+    }
+
+    MD5_Final(MD5res, &mdContext);
+
+    return formatMD5(MD5res);
+}
+
+std::string getDataMD5(const void *data, size_t size)
+{
+    unsigned char MD5res[MD5_DIGEST_LENGTH];
+    MD5(static_cast<const unsigned char *>(data), size, MD5res);
+
+    return formatMD5(MD5res);
+}
+
+bool parseMD5(const char *text, unsigned char *digest)
+{
+    for (size_t i = 0; i < 2 * MD5_DIGEST_LENGTH; i++) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        unsigned char value;
+
+        if (c >= '0' && c <= '9')
+            value = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            value = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            value = c - 'A' + 10;
+        else {
+            return false;
+            /*NOTREACHED*/
+        }
+
+        if (i & 1)
+            digest[i / 2] |= value;
+        else
+            digest[i / 2] = static_cast<unsigned char>(value << 4);
+    }
+
+    return true;
+}
+
+std::string formatMD5(const unsigned char *digest)
+{
+    std::string retVal;
+
+    for (size_t i = 0; i < MD5_DIGEST_LENGTH; i++)
+        retVal += byteToHexStr(digest[i]);
+
+    return (retVal);
+}
+
+bool getFileStat(const fs::path& filePath, FileStat& stat, boost::system::error_code& ec)
+{
+    stat = FileStat();
+    ec.clear();
+
+#ifdef _WIN32
+    //One handle gives the times, the size and the identity at once
+    HANDLE file = CreateFileW(
+        filePath.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL
+    );
+    if (INVALID_HANDLE_VALUE == file) {
+        ec.assign(GetLastError(), boost::system::system_category());
+        return false;
+        /*NOTREACHED*/
+    }
+
+    BY_HANDLE_FILE_INFORMATION info;
+    BOOL isOk = GetFileInformationByHandle(file, &info);
+    if (!isOk) {
+        ec.assign(GetLastError(), boost::system::system_category());
+        CloseHandle(file);
+        return false;
+        /*NOTREACHED*/
+    }
+
+    //Change time is not returned by GetFileInformationByHandle()
+    FILE_BASIC_INFO basicInfo;
+    if (!GetFileInformationByHandleEx(file, FileBasicInfo, &basicInfo, sizeof(basicInfo)))
+        basicInfo.ChangeTime.QuadPart = 0;
+    CloseHandle(file);
+
+    //FILETIME counts 100 ns intervals since 1601
+    auto toTime = [](const FILETIME& ft) -> std::time_t {
+        const unsigned long long ticks = (static_cast<unsigned long long>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+        return static_cast<std::time_t>(ticks / 10000000ULL - 11644473600ULL);
+    };
+    auto toNanoseconds = [](unsigned long long ticks) -> long long {
+        return ticks ? static_cast<long long>(ticks - 116444736000000000ULL) * 100 : 0;
+    };
+
+    stat.size         = (static_cast<unsigned long long>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+    stat.mtime        = toTime(info.ftLastWriteTime);
+    stat.birth_time   = toTime(info.ftCreationTime);
+    stat.mtime_ns     = toNanoseconds((static_cast<unsigned long long>(info.ftLastWriteTime.dwHighDateTime) << 32) |
+                                      info.ftLastWriteTime.dwLowDateTime);
+    stat.ctime_ns     = toNanoseconds(static_cast<unsigned long long>(basicInfo.ChangeTime.QuadPart));
+    stat.device       = info.dwVolumeSerialNumber;
+    stat.inode        = (static_cast<unsigned long long>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    stat.links        = info.nNumberOfLinks;
+    stat.is_directory = (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+
+    stat.is_valid = true;
+    return true;
+#else
+    return getFileStatAt(AT_FDCWD, filePath.c_str(), stat, ec);
+#endif
+}
+
+#ifndef _WIN32
+bool getFileStatAt(int dirFd, const char *name, FileStat& stat, boost::system::error_code& ec)
+{
+    stat = FileStat();
+    ec.clear();
+
+# if defined(__linux__) && defined(STATX_BTIME)
+    //Birth time is returned only if the file system keeps it
+    struct statx stx;
+    if (!statx(dirFd, name, AT_STATX_SYNC_AS_STAT,
+               STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_CTIME | STATX_BTIME | STATX_INO | STATX_NLINK, &stx)) {
+        stat.size         = stx.stx_size;
+        stat.mtime        = static_cast<std::time_t>(stx.stx_mtime.tv_sec);
+        stat.mtime_ns     = static_cast<long long>(stx.stx_mtime.tv_sec) * 1000000000LL + stx.stx_mtime.tv_nsec;
+        stat.ctime_ns     = static_cast<long long>(stx.stx_ctime.tv_sec) * 1000000000LL + stx.stx_ctime.tv_nsec;
+        stat.birth_time   = (stx.stx_mask & STATX_BTIME) ? static_cast<std::time_t>(stx.stx_btime.tv_sec) : stat.mtime;
+        stat.device       = (static_cast<unsigned long long>(stx.stx_dev_major) << 32) | stx.stx_dev_minor;
+        stat.inode        = stx.stx_ino;
+        stat.links        = stx.stx_nlink;
+        stat.is_directory = S_ISDIR(stx.stx_mode);
+        stat.is_valid     = true;
+
+        return true;
+        /*NOTREACHED*/
+    }
+
+    //Kernels older than 4.11 have no statx()
+    if (ENOSYS != errno) {
+        ec.assign(errno, boost::system::system_category());
+        return false;
+        /*NOTREACHED*/
+    }
+# endif
+
+    struct stat st;
+    if (fstatat(dirFd, name, &st, 0)) {
+        ec.assign(errno, boost::system::system_category());
+        return false;
+        /*NOTREACHED*/
+    }
+
+    stat.size         = static_cast<unsigned long long>(st.st_size);
+    stat.mtime        = st.st_mtime;
+# if defined(__APPLE__) || defined(__FreeBSD__)
+    stat.birth_time   = st.st_birthtime;
+# else
+    stat.birth_time   = st.st_mtime;
+# endif
+# if defined(__APPLE__)
+    stat.mtime_ns     = static_cast<long long>(st.st_mtimespec.tv_sec) * 1000000000LL + st.st_mtimespec.tv_nsec;
+    stat.ctime_ns     = static_cast<long long>(st.st_ctimespec.tv_sec) * 1000000000LL + st.st_ctimespec.tv_nsec;
+# else
+    stat.mtime_ns     = static_cast<long long>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+    stat.ctime_ns     = static_cast<long long>(st.st_ctim.tv_sec) * 1000000000LL + st.st_ctim.tv_nsec;
+# endif
+    stat.device       = st.st_dev;
+    stat.inode        = st.st_ino;
+    stat.links        = st.st_nlink;
+    stat.is_directory = S_ISDIR(st.st_mode);
+
+    stat.is_valid = true;
+    return true;
+}
+#endif
+
+std::string getHumanReadableSize(long long fileSize)
+{
+    static const auto _SIZE_TB = 1024LL * 1024LL * 1024LL * 1024LL;
+    static const char *sizesPrefix[] = { " Tera ", " Giga ", " Mega ", " Kilo ", " " };
+
+    if (!fileSize) {
+        return std::string("0 bytes");
+        //NOTREACHED
+    }
+
+    std::string retVal;
+
+    long long curSize;
+    long long delim = _SIZE_TB;
+
+    for (size_t i = 0; i < _array_size(sizesPrefix); i++, delim /= 1024LL) {
+        curSize = fileSize / delim;
+        fileSize %= delim;
+        
+        if (curSize) {
+            retVal += std::to_string(curSize) + sizesPrefix[i];
+            retVal += (1 == curSize) ? "byte " : "bytes ";
+        }
+    }
+    //Remove last space symbol
+    retVal.erase(retVal.end() - 1);
+
+    return (retVal);
+}
+
+long long parseHumanReadableSize(const std::string& text)
+{
+    static const char *sizesPrefix[] = { "Tera", "Giga", "Mega", "Kilo" };
+
+    std::istringstream tokens(text);
+    std::string unit;
+    long long retVal = 0;
+    long long count;
+
+    //Every part is "<count> [<prefix>] byte[s]"
+    while (tokens >> count >> unit) {
+        long long factor = 1;
+
+        for (size_t i = 0; i < _array_size(sizesPrefix); i++) {
+            if (unit == sizesPrefix[i]) {
+                factor = 1024LL << (10 * (_array_size(sizesPrefix) - 1 - i));
+                tokens >> unit;
+                break;
+            }
+        }
+
+        if (unit != "byte" && unit != "bytes") {
+            return -1;
+            //NOTREACHED
+        }
+
+        retVal += count * factor;
+    }
+
+    if (!tokens.eof()) {
+        return -1;
+        //NOTREACHED
+    }
+
+    return (retVal);
+}
+
+void updateBlockMD5(MD5_CTX& blockContext, size_t& blockFill, size_t blockSize,
+                    const unsigned char *data, size_t size, std::vector<std::string>& blockDigests)
+{
+    while (size) {
+        size_t part = std::min(size, blockSize - blockFill);
+
+        MD5_Update(&blockContext, data, part);
+        blockFill += part;
+        data += part;
+        size -= part;
+
+        if (blockFill == blockSize) {
+            unsigned char blockRes[MD5_DIGEST_LENGTH];
+            MD5_Final(blockRes, &blockContext);
+            blockDigests.push_back(formatMD5(blockRes));
+
+            MD5_Init(&blockContext);
+            blockFill = 0;
+        }
+    }
+}
+
+std::string byteToHexStr(unsigned char ch)
+{
+    std::string retVal(2, 0);
+
+    std::sprintf(&retVal[0], "%02x", ch);
+
+    return (retVal);
+}
+
+//
+//
+//
@@ -1,38 +1,172 @@
-//
-// -*- Mode: c++; tab-width: 4; -*-
-// -*- ex: ts=4 -*-
-//
-
-//
-// FileInfoExtractor.h (V. Drozd)
-// src/modules/FileInfoLogger/src/FileInfoExtractor.h
-//
-
-//
-// Provides functionality to fetch main information about the file
-//
-
-//
-// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
-// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
-// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
-//
-
-///////////////////////////////////////////////////////////////////////////////
-// %% BeginSection: includes
-//
-
-#pragma once
-
-#include "CalculateSum/Types.h"
-
-
-///////////////////////////////////////////////////////////////////////////////
-// %% BeginSection: declarations
-//
-
-FileInfo FileInfoExtract(fs::path& filePath);
-
-//
-//
-//
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileInfoExtractor.h (V. Drozd)
+// src/modules/FileInfoLogger/src/FileInfoExtractor.h
+//
+
+//
+// Provides functionality to fetch main information about the file
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include "CalculateSum/Types.h"
+#include "CalculateSum/Fingerprint.h"
+#include "CalculateSum/FileRecord.h"
+
+#include <ctime>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declarations
+//
+
+class ContentChunker;
+
+//
+// Lets the caller watch the extraction, all times are steady clock ticks
+//
+
+struct ExtractProgress {
+    //Time of the last successful read (0 - extraction isn't started yet)
+    std::atomic<long long> last_activity;
+
+    //Extraction fails with ETIMEDOUT when it isn't finished till this time (0 - no limit)
+    long long              deadline;
+};
+
+//
+// Identity of the file data, the same for all hard links of the file
+//
+
+struct FileIdentity {
+    unsigned long long device;
+    unsigned long long inode;
+
+    bool operator<(const FileIdentity& other) const
+    {
+        return (device != other.device) ? device < other.device : inode < other.inode;
+    }
+};
+
+inline long long steadyTicks()
+{
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+//
+// Digests of every blockSize bytes of the file are calculated in the same pass
+// if blockDigests is set (they are left empty for the file of one block),
+// the data is split into content defined chunks as well if chunker is set.
+// Sampled fingerprint is calculated instead of MD5 if fingerprint is set
+// (blocks and chunks are not calculated then, the file isn't read completely).
+// Size and creation time are taken from the valid stat, the file is stat'ed otherwise.
+// The record references filePath, its digest type is left for the caller
+// (NULL - MD5), FileInfoExtract() makes the text of it at once
+//
+
+FileRecord FileRecordExtract(fs::path& filePath, ExtractProgress *progress = NULL,
+                             size_t blockSize = 0, std::vector<std::string> *blockDigests = NULL,
+                             ContentChunker *chunker = NULL, const FingerprintSpec *fingerprint = NULL,
+                             const FileStat *stat = NULL);
+
+FileInfo FileInfoExtract(fs::path& filePath, ExtractProgress *progress = NULL,
+                         size_t blockSize = 0, std::vector<std::string> *blockDigests = NULL,
+                         ContentChunker *chunker = NULL, const FingerprintSpec *fingerprint = NULL,
+                         const FileStat *stat = NULL);
+
+//
+// MD5 of the whole file (and of its blocks and chunks, if they are requested),
+// as text or as 16 bytes
+//
+
+std::string getFileMD5(fs::path& filePath, boost::system::error_code& ec, ExtractProgress *progress = NULL,
+                       size_t blockSize = 0, std::vector<std::string> *blockDigests = NULL,
+                       ContentChunker *chunker = NULL);
+
+bool getFileMD5(fs::path& filePath, unsigned char *digest, boost::system::error_code& ec,
+                ExtractProgress *progress = NULL, size_t blockSize = 0,
+                std::vector<std::string> *blockDigests = NULL, ContentChunker *chunker = NULL);
+
+//
+// Sampled fingerprint of the file, see Fingerprint.h
+//
+
+std::string getFileFingerprint(fs::path& filePath, long long fileSize, const FingerprintSpec& spec,
+                               boost::system::error_code& ec, ExtractProgress *progress = NULL);
+
+bool getFileFingerprint(fs::path& filePath, long long fileSize, const FingerprintSpec& spec,
+                        unsigned char *digest, boost::system::error_code& ec, ExtractProgress *progress = NULL);
+
+//
+// MD5 of length bytes from offset (less at the end of the file)
+//
+
+std::string getFileRangeMD5(const fs::path& filePath, long long offset, size_t length, boost::system::error_code& ec);
+
+//
+// MD5 of the first and the last edgeSize bytes only (of the whole file if it is smaller)
+//
+
+std::string getFileEdgesMD5(fs::path& filePath, long long fileSize, size_t edgeSize, boost::system::error_code& ec);
+
+//
+// MD5 of the data in memory, in the same text form as the file digests
+//
+
+std::string getDataMD5(const void *data, size_t size);
+
+//
+// Conversion of the digest between its text and binary (16 bytes) forms,
+// parseMD5() returns false if the text isn't 32 hex digits
+//
+
+bool parseMD5(const char *text, unsigned char *digest);
+std::string formatMD5(const unsigned char *digest);
+
+//
+// All metadata of the file by one call: statx() on Linux (with the birth time),
+// stat() on the other systems, GetFileInformationByHandle() on Windows
+//
+
+bool getFileStat(const fs::path& filePath, FileStat& stat, boost::system::error_code& ec);
+
+#ifndef _WIN32
+//The same for the entry name of the open directory dirFd (AT_FDCWD - the path)
+bool getFileStatAt(int dirFd, const char *name, FileStat& stat, boost::system::error_code& ec);
+#endif
+
+//
+// Text representation of the fields, the same as FileInfoExtract produces
+//
+
+std::string getHumanReadableSize(long long fileSize);
+std::string formatTimeCreation(std::time_t time);
+
+//
+// Restore the exact size from getHumanReadableSize() text, -1 if it is malformed
+//
+
+long long parseHumanReadableSize(const std::string& text);
+
+//
+//
+//
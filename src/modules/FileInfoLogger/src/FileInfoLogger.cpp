@@ -1,235 +1,1401 @@
-//
-// -*- Mode: c++; tab-width: 4; -*-
-// -*- ex: ts=4 -*-
-//
-
-//
-// FileInfoLogger.cpp    (V. Drozd)
-// src/modules/FileInfoLogger/src/FileInfoLogger.cpp
-//
-
-//
-// Main class that provide logging information about files
-//
-
-//
-// @todo: 
-// 1. add normal error handling
-//
-
-//
-//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
-//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
-//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
-//
-
-///////////////////////////////////////////////////////////////////////////////
-// %% BeginSection: includes
-//
-
-#define _CRT_SECURE_NO_WARNINGS
-
-#include "CalculateSum/FileInfoLogger.h"
-#include "FileInfoExtractor.h"
-
-#include "ThreadPool.h"
-
-#include <algorithm>
-
-#include <sstream>
-#include <fstream>
-
-///////////////////////////////////////////////////////////////////////////////
-// %% BeginSection: public function member definitions
-//
-
-FileInfoLogger::FileInfoLogger(std::vector<std::wstring>& filePaths, std::wstring& logFilePath)
-    : file_paths(filePaths.begin(), filePaths.end())
-    , log_file_path(logFilePath)
-{
-    internalInit();
-}
-
-FileInfoLogger::FileInfoLogger(std::vector<std::string>& filePaths, std::string& logFilePath)
-    : file_paths(filePaths.begin(), filePaths.end())
-    , log_file_path(logFilePath)
-{
-    internalInit();
-}
-
-FileInfoLogger::FileInfoLogger(std::vector<fs::path>& filePaths, fs::path& logFilePath)
-    : file_paths(filePaths.begin(), filePaths.end())
-    , log_file_path(logFilePath)
-{
-    internalInit();
-}
-
-bool FileInfoLogger::process()
-{
-    // wrap the main function
-    auto binded_fn = std::bind(&FileInfoLogger::writeResultsIntoLog, this);
-    auto task = std::packaged_task<bool()>(binded_fn);
-
-    std::future<bool> result = task.get_future();
-
-    //And run main task in thread
-    std::thread(std::move(task)).detach();
-
-    //Create thread pool with optimal size for logger
-    ThreadPool pool(std::max(1U, std::thread::hardware_concurrency() - 1));
-
-    //Add tasks for calculating file information
-    for (size_t i = 0; i < file_paths.size(); ++i) {
-        fs::path &cpath = file_paths[i];
-        results[i] = pool.addTask(
-            [this, &cpath, i]() { return infoExtractorWrapper(cpath, i); }
-        );
-    }
-
-    //Wait for result
-    //That mean all task is done or an error occurred
-    result.wait();
-
-    bool status = result.get();
-    
-    //false == status -> error occurred and we must clear task queue
-    if (!status)
-        pool.clearTaskQueue();
-
-    return (status);
-    
-}
-///////////////////////////////////////////////////////////////////////////////
-// %% BeginSection: private function member definitions
-//
-
-void FileInfoLogger::internalInit()
-{
-    //Fisrt of all check if fNames containts logFilePath_
-    fs::path cpath(log_file_path);
-    auto finded = std::find_if(
-        file_paths.begin(),
-        file_paths.end(),
-        [&cpath](const fs::path& thisPath) {
-            return fs::equivalent(thisPath, cpath);
-        }
-    );
-    if (finded != file_paths.end()) {
-        file_paths.erase(finded);
-    }
-
-    //Delete all directory paths
-    file_paths.erase(
-        std::remove_if(
-            file_paths.begin(),
-            file_paths.end(),
-            [](const fs::path& thisPath) { return fs::is_directory(thisPath); }
-        ),
-        file_paths.end()
-    );
-
-    //Sort file list in alphabetical order
-    std::sort(file_paths.begin(), file_paths.end());
-
-    //Allocate memory for results
-    results.resize(file_paths.size());
-}
-
-void inline updateOffsets(std::vector<long>& offsets, int pos, long val)
-{
-    long diff = (!pos ? offsets[0] : offsets[pos] - offsets[pos - 1]) - val;
-    
-    for (size_t cp = pos; cp < offsets.size(); cp++) {
-        offsets[cp] -= diff;
-    }
-}
-
-bool FileInfoLogger::writeResultsIntoLog()
-{
-    //Open (create) logFile
-    std::fstream file(log_file_path.c_str(), std::ios::out | std::ios::in | std::ios::trunc);
-    if (!file.is_open()) {
-        return false;
-        //NOTREACHED
-    }
-
-    std::string res;
-
-    std::vector<bool> visited(file_paths.size());
-    std::vector<long> offsets(file_paths.size());
-    size_t visitedCount = 0;
-
-    is_extract_done = false;
-
-    while (visitedCount != file_paths.size()) {
-        //Wait for one work is done
-        {
-            std::unique_lock<std::mutex> lock(extract_done_mutex);
-
-            while (!is_extract_done)
-                extract_done_condition.wait(lock);
-
-            //and wait for result
-            auto idx = idx_extract_done_task;
-            while (!results[idx]._Is_ready());
-        }
-        is_extract_done = false;
-
-        for (size_t i = 0; i < file_paths.size(); i++) {
-            
-            if (visited[i] || !results[i]._Is_ready()) continue;
-
-            FileInfo finfo = results[i].get();
-            
-            //@todo: Need correct error handling
-            if (!finfo.is_correct) {
-                return false;
-                //NOTREACHED
-            }
-
-            res = finfo.toString();
-            // Rewrite the file
-            {
-                std::stringstream buffer;
-
-                //Go to position for insert new line
-                file.seekp(offsets[i], std::ios_base::beg);
-
-                //Read and save in string stream all text that must be rewrited
-                buffer << file.rdbuf();
-
-                //Write new data in file
-                file.seekp(offsets[i], std::ios_base::beg);
-                file << res.c_str();
-
-                //Paste saved data from string stream
-                file << buffer.str().c_str();
-                updateOffsets(offsets, i, res.length() + 1);
-            }
-
-            visited[i] = true;
-            visitedCount++;
-        }
-    }
-
-    file.close();
-    return true;
-}
-
-FileInfo FileInfoLogger::infoExtractorWrapper(fs::path& fpath, size_t idx)
-{
-    FileInfo retVal = FileInfoExtract(fpath);
-
-    {
-        std::unique_lock<std::mutex> lock(extract_done_mutex);
-        is_extract_done = true;
-        idx_extract_done_task = idx;
-        extract_done_condition.notify_one(); //Wake up main thread
-    }
-
-    return (retVal);
-}
-
-//
-//
-//
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileInfoLogger.cpp    (V. Drozd)
+// src/modules/FileInfoLogger/src/FileInfoLogger.cpp
+//
+
+//
+// Main class that provide logging information about files
+//
+
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "CalculateSum/FileInfoLogger.h"
+#include "CalculateSum/KnownHashSet.h"
+#include "CalculateSum/FileInfoSink.h"
+#include "CalculateSum/BlockHashList.h"
+#include "CalculateSum/DirectoryWalker.h"
+#include "FileInfoExtractor.h"
+#include "ContentChunker.h"
+#include "LogReader.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: variable definitions
+//
+
+//Journal is flushed after this number of records or this time interval
+static const size_t       _s_journalFlushRecords  = 256;
+static const unsigned int _s_journalFlushInterval = 1;
+
+//Files found by the walker are queued at least so often while the result is awaited
+static const unsigned int _s_pullIntervalMs = 20;
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: type definitions
+//
+
+struct FileInfoLogger::TaskIntake {
+    ThreadPool&                    pool;
+    const PrevInfoMap&             prev_info;
+    std::time_t                    prev_time;
+    const JournalMap&              journal_info;
+
+    //Files that are hashed by this run, by identity of their data
+    std::map<FileIdentity, size_t> hashed_files;
+
+    TaskIntake(ThreadPool& taskPool, const PrevInfoMap& prevInfo, std::time_t prevTime, const JournalMap& journalInfo)
+        : pool(taskPool)
+        , prev_info(prevInfo)
+        , prev_time(prevTime)
+        , journal_info(journalInfo)
+    {
+    }
+};
+
+//
+// Copy of everything the worker uses while it reads the file. The worker that
+// hangs in the system call (e.g. in the read of the FIFO or of the dead network
+// share) can't be interrupted, so it is abandoned with its own copy of the data
+// and it may come back when the logger is gone.
+//
+
+struct FileInfoLogger::TaskState {
+    fs::path                       path;
+    FileStat                       stat;
+    ExtractProgress                progress;
+    bool                           is_watched;       //progress is tracked (timeouts are set)
+    unsigned int                   file_deadline;
+    size_t                         block_size;
+    bool                           is_chunking;
+    bool                           is_fingerprint;
+    FingerprintSpec                fingerprint_spec;
+    std::vector<std::string>       block_digests;
+    std::vector<ChunkList::Chunk>  chunks;
+
+    //Logger doesn't wait for the result anymore, the worker must not touch it @{
+    std::mutex                     mutex;
+    std::thread::id                worker;
+    bool                           is_abandoned;
+    //@}
+
+    TaskState()
+        : progress()
+        , is_watched(false)
+        , file_deadline(0)
+        , block_size(0)
+        , is_chunking(false)
+        , is_fingerprint(false)
+        , is_abandoned(false)
+    {
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: public function member definitions
+//
+
+FileInfoLogger::FileInfoLogger(std::vector<std::wstring>& filePaths, std::wstring& logFilePath)
+    : FileInfoLogger(fs::path(logFilePath), NULL)
+{
+    file_paths.assign(filePaths.begin(), filePaths.end());
+    internalInit();
+}
+
+FileInfoLogger::FileInfoLogger(std::vector<std::string>& filePaths, std::string& logFilePath)
+    : FileInfoLogger(fs::path(logFilePath), NULL)
+{
+    file_paths.assign(filePaths.begin(), filePaths.end());
+    internalInit();
+}
+
+FileInfoLogger::FileInfoLogger(std::vector<fs::path>& filePaths, fs::path& logFilePath)
+    : FileInfoLogger(logFilePath, NULL)
+{
+    file_paths.assign(filePaths.begin(), filePaths.end());
+    internalInit();
+}
+
+FileInfoLogger::FileInfoLogger(DirectoryWalker& walker, fs::path& logFilePath)
+    : FileInfoLogger(logFilePath, &walker)
+{
+}
+
+FileInfoLogger::FileInfoLogger(const fs::path& logFilePath, DirectoryWalker *walker)
+    : log_file_path(logFilePath)
+    , tmp_log_file_path(log_file_path.string() + ".tmp")
+    , root_dir(walker ? walker->rootDir() : fs::path())
+    , file_walker(walker)
+    , is_walk_finished(true)
+    , task_intake(NULL)
+    , is_incremental(false)
+    , is_checkpointing(false)
+    , failure_threshold(static_cast<size_t>(-1))
+    , failed_count(0)
+    , stall_timeout(0)
+    , file_deadline(0)
+    , is_link_detection(true)
+    , shard_index(0)
+    , shard_count(1)
+    , known_hashes(NULL)
+    , known_count(0)
+    , sink(NULL)
+    , is_completion_order(false)
+    , compression_level(0)
+    , block_size(0)
+    , block_list_path(log_file_path.string() + ".blocks")
+    , tmp_block_list_path(block_list_path.string() + ".tmp")
+    , is_fingerprint(false)
+    , is_chunking(false)
+    , chunk_list_path(log_file_path.string() + ".chunks")
+    , tmp_chunk_list_path(chunk_list_path.string() + ".tmp")
+    , journal_path(log_file_path.string() + ".journal")
+    , journal_pending(0)
+{
+}
+
+FileInfoLogger::~FileInfoLogger()
+{
+}
+
+void FileInfoLogger::setIncrementalUpdate(bool enable)
+{
+    is_incremental = enable;
+}
+
+void FileInfoLogger::setCheckpointing(bool enable)
+{
+    is_checkpointing = enable;
+}
+
+void FileInfoLogger::setFailureThreshold(size_t maxFailures)
+{
+    failure_threshold = maxFailures;
+}
+
+size_t FileInfoLogger::failedCount() const
+{
+    return failed_count;
+}
+
+void FileInfoLogger::setStallTimeout(unsigned int seconds)
+{
+    stall_timeout = seconds;
+    stall_reason = "no progress for " + std::to_string(seconds) + " seconds";
+}
+
+void FileInfoLogger::setFileDeadline(unsigned int seconds)
+{
+    file_deadline = seconds;
+}
+
+void FileInfoLogger::setHardLinkDetection(bool enable)
+{
+    is_link_detection = enable;
+}
+
+void FileInfoLogger::setShard(unsigned int index, unsigned int count)
+{
+    shard_count = std::max(1U, count);
+    shard_index = index % shard_count;
+}
+
+void FileInfoLogger::setKnownHashSet(const KnownHashSet *knownHashes)
+{
+    known_hashes = knownHashes;
+}
+
+size_t FileInfoLogger::knownCount() const
+{
+    return known_count;
+}
+
+void FileInfoLogger::setCompression(int level)
+{
+    compression_level = level;
+}
+
+void FileInfoLogger::setBlockDigests(size_t blockSize)
+{
+    block_size = blockSize;
+}
+
+void FileInfoLogger::setContentChunking(bool enable)
+{
+    is_chunking = enable;
+}
+
+const fs::path& FileInfoLogger::chunkListPath() const
+{
+    return chunk_list_path;
+}
+
+void FileInfoLogger::setFingerprint(const FingerprintSpec *spec)
+{
+    is_fingerprint = (spec != NULL);
+    if (spec)
+        fingerprint_spec = *spec;
+
+    //Records of the files reference it
+    digest_label = spec ? spec->label() : std::string();
+}
+
+void FileInfoLogger::setRootDirectory(const fs::path& rootDir)
+{
+    root_dir = rootDir;
+}
+
+void FileInfoLogger::setFilterSpec(const FileFilterSpec& spec)
+{
+    filter_spec = spec;
+}
+
+void FileInfoLogger::setSink(FileInfoSink *sink, bool completionOrder)
+{
+    this->sink = sink;
+    is_completion_order = completionOrder;
+}
+
+bool FileInfoLogger::process()
+{
+    //Files changed after this moment must be rehashed by the next update
+    std::time_t startTime = std::time(nullptr);
+
+    if (file_walker) {
+        //Files are taken from the walker while the first of them are calculated
+        file_paths.clear();
+        results.clear();
+
+        file_stats.clear();
+
+        if (!filter_spec.isEmpty())
+            file_walker->setFilterSpec(filter_spec);
+
+        //Metadata comes from the reading threads along with the paths
+        file_walker->setFileStats(true);
+
+        if (!file_walker->start()) {
+            return false;
+            //NOTREACHED
+        }
+
+        is_walk_finished = false;
+    }
+    else {
+        //Shard is chosen by the name, so only its own files are stat'ed
+        if (shard_count > 1)
+            applyShard();
+
+        takeFileStats();
+
+        if (!filter_spec.isEmpty())
+            applyFilter();
+    }
+
+    //Results of the previous run (for incremental update only)
+    PrevInfoMap prevInfo;
+    std::time_t prevTime = 0;
+
+    if (is_incremental && !loadPreviousLog(prevInfo, prevTime))
+        prevInfo.clear();
+
+    //Block digests of the reused records are taken from the previous sidecar
+    block_digests.assign(block_size ? file_paths.size() : 0, std::vector<std::string>());
+    prev_blocks.clear();
+    prev_chunks.clear();
+
+    if (block_size && !prevInfo.empty())
+        loadPreviousBlocks();
+
+    //And their chunks as well
+    file_chunks.assign(is_chunking ? file_paths.size() : 0, std::vector<ChunkList::Chunk>());
+    prev_chunks.clear();
+
+    if (is_chunking && !prevInfo.empty())
+        loadPreviousChunks();
+
+    //Records calculated by the interrupted run
+    JournalMap journalInfo;
+
+    if (is_checkpointing) {
+        loadJournal(journalInfo);
+
+        //Old records are kept, so they survive one more interruption
+        journal.open(journal_path.c_str(), std::ios::out | std::ios::app | std::ios::binary);
+        journal_pending = 0;
+        journal_flush_time = std::chrono::steady_clock::now();
+    }
+
+    bool status;
+
+    task_states.clear();
+    if (stall_timeout || file_deadline)
+        task_states.resize(file_paths.size());
+
+    link_primary.resize(file_paths.size());
+    for (size_t i = 0; i < link_primary.size(); ++i)
+        link_primary[i] = i;
+    linked_info.clear();
+    done_tasks.clear();
+
+    {
+        //Create thread pool with optimal size for logger
+        ThreadPool pool(std::max(1U, std::thread::hardware_concurrency() - 1));
+        TaskIntake intake(pool, prevInfo, prevTime, journalInfo);
+        task_intake = &intake;
+
+        //Add tasks for calculating file information
+        for (size_t i = 0; i < file_paths.size(); ++i)
+            submitTask(i);
+
+        //Write results in the same time as they are calculated by the pool
+        //(the files of the walker are added while they are written)
+        status = writeResults(pool);
+        task_intake = NULL;
+
+        //false == status -> error occurred and we must clear task queue
+        if (!status)
+            pool.clearTaskQueue();
+    }
+
+    //All workers are finished, so the journal can be closed
+    if (journal.is_open())
+        journal.close();
+
+    prev_blocks.clear();
+
+    //The previous log stays as it was, so the next incremental update
+    //does not trust the records of the failed run
+    if (!status) {
+        removeTmpOutput();
+        return (status);
+        //NOTREACHED
+    }
+
+    if (!replaceOutput(startTime)) {
+        removeTmpOutput();
+        return false;
+        //NOTREACHED
+    }
+
+    //The log is complete, so the journal is not needed anymore
+    boost::system::error_code ec;
+    if (is_checkpointing)
+        fs::remove(journal_path, ec);
+
+    return (status);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: private function member definitions
+//
+
+void FileInfoLogger::internalInit()
+{
+    //The log itself, journal of the interrupted run and the sidecars must not be logged
+    file_paths.erase(
+        std::remove_if(
+            file_paths.begin(),
+            file_paths.end(),
+            [this](const fs::path& thisPath) { return isOwnFile(thisPath); }
+        ),
+        file_paths.end()
+    );
+
+    //Sort file list in alphabetical order
+    std::sort(file_paths.begin(), file_paths.end());
+
+    //Allocate memory for results
+    results.resize(file_paths.size());
+}
+
+void FileInfoLogger::applyShard()
+{
+    file_paths.erase(
+        std::remove_if(
+            file_paths.begin(),
+            file_paths.end(),
+            [this](const fs::path& thisPath) { return !isInShard(thisPath); }
+        ),
+        file_paths.end()
+    );
+
+    //The rest is still sorted
+    results.resize(file_paths.size());
+}
+
+void FileInfoLogger::applyFilter()
+{
+    size_t kept = 0;
+
+    for (size_t i = 0; i < file_paths.size(); i++) {
+        if (!filter_spec.isPathIncluded(FileRecord::nameOf(root_dir, file_paths[i]), file_stats[i]))
+            continue;
+
+        if (kept != i) {
+            file_paths[kept].swap(file_paths[i]);
+            file_stats[kept] = file_stats[i];
+        }
+        kept++;
+    }
+
+    //The rest is still sorted
+    file_paths.resize(kept);
+    file_stats.resize(kept);
+    results.resize(kept);
+}
+
+void FileInfoLogger::takeFileStats()
+{
+    file_stats.clear();
+
+    size_t kept = 0;
+
+    for (size_t i = 0; i < file_paths.size(); i++) {
+        FileStat stat;
+        boost::system::error_code ec;
+
+        //File that can't be stat'ed is logged with the reason, directory is not logged
+        getFileStat(file_paths[i], stat, ec);
+        if (stat.is_directory)
+            continue;
+
+        if (kept != i)
+            file_paths[kept].swap(file_paths[i]);
+        file_stats.push_back(stat);
+        kept++;
+    }
+
+    file_paths.resize(kept);
+    results.resize(kept);
+}
+
+bool FileInfoLogger::isOwnFile(const fs::path& filePath) const
+{
+    const fs::path* ownFiles[] = { &log_file_path, &tmp_log_file_path, &journal_path,
+                                   &block_list_path, &tmp_block_list_path,
+                                   &chunk_list_path, &tmp_chunk_list_path };
+    const fs::path name = filePath.filename();
+
+    //Names are compared first, so only the namesakes are checked by the file system
+    for (size_t i = 0; i < sizeof(ownFiles) / sizeof(ownFiles[0]); i++) {
+        boost::system::error_code ec;
+
+        if (name == ownFiles[i]->filename() && fs::equivalent(filePath, *ownFiles[i], ec)) {
+            return true;
+            //NOTREACHED
+        }
+    }
+
+    return false;
+}
+
+bool FileInfoLogger::isInShard(const fs::path& filePath) const
+{
+    //FNV-1a, the same on every platform and in every process
+    static const unsigned long long fnvOffset = 14695981039346656037ULL;
+    static const unsigned long long fnvPrime  = 1099511628211ULL;
+
+    const std::string name = FileRecord::nameOf(root_dir, filePath);
+
+    unsigned long long hash = fnvOffset;
+    for (size_t i = 0; i < name.size(); i++) {
+        hash ^= static_cast<unsigned char>(name[i]);
+        hash *= fnvPrime;
+    }
+
+    return (hash % shard_count == shard_index);
+}
+
+void FileInfoLogger::submitTask(const size_t taskIdx)
+{
+    TaskIntake& intake = *task_intake;
+
+    if (!intake.prev_info.empty() && reusePreviousInfo(intake.prev_info, intake.prev_time, taskIdx)) {
+        return;
+        //NOTREACHED
+    }
+
+    if (!intake.journal_info.empty() && reuseJournalInfo(intake.journal_info, taskIdx)) {
+        return;
+        //NOTREACHED
+    }
+
+    if (is_link_detection && isLinkOfHashedFile(intake.hashed_files, taskIdx)) {
+        return;
+        //NOTREACHED
+    }
+
+    //Fingerprint doesn't read the whole file, so blocks and chunks are not calculated
+    TaskSlots slots;
+    slots.path = &file_paths[taskIdx];
+    slots.block_digests = (block_size && !is_fingerprint) ? &block_digests[taskIdx] : NULL;
+    slots.chunks = (is_chunking && !is_fingerprint) ? &file_chunks[taskIdx] : NULL;
+
+    std::shared_ptr<TaskState> state = std::make_shared<TaskState>();
+    state->path = file_paths[taskIdx];
+    state->stat = file_stats[taskIdx];
+    state->is_watched = stall_timeout || file_deadline;
+    state->file_deadline = file_deadline;
+    state->block_size = slots.block_digests ? block_size : 0;
+    state->is_chunking = slots.chunks != NULL;
+    state->is_fingerprint = is_fingerprint;
+    if (is_fingerprint)
+        state->fingerprint_spec = fingerprint_spec;
+
+    if (state->is_watched)
+        task_states[taskIdx] = state;
+
+    results[taskIdx] = intake.pool.addTask(
+        [this, taskIdx, slots, state]() { return infoExtractorWrapper(taskIdx, slots, state); }
+    );
+}
+
+bool FileInfoLogger::pullFiles(bool wait)
+{
+    if (is_walk_finished) {
+        return false;
+        //NOTREACHED
+    }
+
+    std::vector<fs::path> batch;
+    std::vector<FileStat> stats;
+    if (!file_walker->next(batch, stats, wait)) {
+        is_walk_finished = true;
+        return false;
+        //NOTREACHED
+    }
+
+    //Files come in the order of the log, so they are just appended
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (isOwnFile(batch[i]) || (shard_count > 1 && !isInShard(batch[i])))
+            continue;
+
+        const size_t taskIdx = file_paths.size();
+
+        file_paths.push_back(batch[i]);
+        file_stats.push_back(stats[i]);
+        results.push_back(std::future<FileRecord>());
+        link_primary.push_back(taskIdx);
+
+        if (block_size)
+            block_digests.push_back(std::vector<std::string>());
+
+        if (is_chunking)
+            file_chunks.push_back(std::vector<ChunkList::Chunk>());
+
+        if (stall_timeout || file_deadline)
+            task_states.push_back(std::shared_ptr<TaskState>());
+
+        submitTask(taskIdx);
+    }
+
+    return true;
+}
+
+bool FileInfoLogger::writeResults(ThreadPool& pool)
+{
+    //Records go to the log file, unless the other sink is set
+    std::unique_ptr<FileInfoSink> logSink;
+    FileInfoSink *out = sink;
+
+    if (!out) {
+        if (compression_level > 0)
+            logSink.reset(new GzipLogSink(tmp_log_file_path, compression_level));
+        else
+            logSink.reset(new TextLogSink(tmp_log_file_path));
+
+        out = logSink.get();
+    }
+
+    if (!out->open()) {
+        return false;
+        //NOTREACHED
+    }
+
+    if (block_size) {
+        block_list.open(tmp_block_list_path.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!block_list.is_open()) {
+            return false;
+            //NOTREACHED
+        }
+    }
+
+    if (is_chunking) {
+        chunk_list.open(tmp_chunk_list_path.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!chunk_list.is_open()) {
+            block_list.close();
+            return false;
+            //NOTREACHED
+        }
+    }
+
+    failed_count = 0;
+    known_count = 0;
+
+    bool status = is_completion_order ? writeInCompletionOrder(pool, *out) : writeInOrder(pool, *out);
+
+    if (block_list.is_open()) {
+        block_list.close();
+        status = status && !block_list.fail();
+    }
+
+    if (chunk_list.is_open()) {
+        chunk_list.close();
+        status = status && !chunk_list.fail();
+    }
+
+    if (!status) {
+        return false;
+        //NOTREACHED
+    }
+
+    return out->close();
+}
+
+bool FileInfoLogger::replaceOutput(std::time_t startTime)
+{
+    boost::system::error_code ec;
+
+    //Sidecars go first, the log is the last one, so a complete log
+    //never comes with the sidecars of the previous run
+    if (block_size) {
+        fs::rename(tmp_block_list_path, block_list_path, ec);
+        if (ec) {
+            return false;
+            //NOTREACHED
+        }
+    }
+
+    if (is_chunking) {
+        fs::rename(tmp_chunk_list_path, chunk_list_path, ec);
+        if (ec) {
+            return false;
+            //NOTREACHED
+        }
+    }
+
+    if (sink) {
+        return true;
+        //NOTREACHED
+    }
+
+    //Mark the log with the start time, so the next incremental update
+    //could detect files that were modified during or after this run
+    fs::last_write_time(tmp_log_file_path, startTime, ec);
+    fs::rename(tmp_log_file_path, log_file_path, ec);
+
+    return !ec;
+}
+
+void FileInfoLogger::removeTmpOutput()
+{
+    boost::system::error_code ec;
+
+    fs::remove(tmp_log_file_path, ec);
+    fs::remove(tmp_block_list_path, ec);
+    fs::remove(tmp_chunk_list_path, ec);
+}
+
+bool FileInfoLogger::writeInOrder(ThreadPool& pool, FileInfoSink& out)
+{
+    //Results are already in alphabetical order,
+    //so just wait for each of them in turn and append it to the log
+    for (size_t i = 0; ; i++) {
+        //All known files are written, so the next ones are awaited from the walker
+        while (i == results.size() && pullFiles(true)) {
+        }
+
+        if (i == results.size())
+            break;
+
+        FileRecord record;
+
+        //Hard link takes the result of its first link, which is already written
+        if (link_primary[i] != i) {
+            record = linked_info[link_primary[i]];
+            record.path = &file_paths[i];
+        }
+        //Worker hangs in the system call, leave it there and go on
+        else if (!waitResult(i, record)) {
+            abandonTask(pool, i);
+        }
+
+        auto linked = linked_info.find(i);
+        if (linked != linked_info.end())
+            linked->second = record;
+
+        if (!writeRecord(i, record, out)) {
+            return false;
+            //NOTREACHED
+        }
+    }
+
+    return true;
+}
+
+bool FileInfoLogger::writeInCompletionOrder(ThreadPool& pool, FileInfoSink& out)
+{
+    //Hard links are written right after their first link
+    std::multimap<size_t, size_t> aliases;
+    size_t pending = 0;
+    size_t counted = 0;
+
+    //Result of the hung task is written once, when it is timed out
+    std::vector<bool> written;
+
+    for (;;) {
+        //Files of the walker are counted as they are added
+        written.resize(results.size(), false);
+
+        for (; counted < link_primary.size(); counted++) {
+            const size_t primary = link_primary[counted];
+
+            if (primary == counted) {
+                pending++;
+                continue;
+            }
+
+            if (!written[primary]) {
+                aliases.insert(std::make_pair(primary, counted));
+                continue;
+            }
+
+            //Its first link is already written
+            FileRecord linkRecord(linked_info[primary]);
+            linkRecord.path = &file_paths[counted];
+
+            written[counted] = true;
+
+            if (!writeRecord(counted, linkRecord, out)) {
+                return false;
+                //NOTREACHED
+            }
+        }
+
+        if (!pending) {
+            if (pullFiles(true))
+                continue;
+
+            break;
+        }
+
+        size_t idx;
+        FileRecord record;
+
+        if (!waitCompleted(written, idx, record))
+            abandonTask(pool, idx);
+
+        pending--;
+
+        if (idx >= written.size())
+            written.resize(idx + 1, false);
+        written[idx] = true;
+
+        auto linked = linked_info.find(idx);
+        if (linked != linked_info.end())
+            linked->second = record;
+
+        if (!writeRecord(idx, record, out)) {
+            return false;
+            //NOTREACHED
+        }
+
+        auto range = aliases.equal_range(idx);
+        for (auto alias = range.first; alias != range.second; ++alias) {
+            FileRecord linkRecord(record);
+            linkRecord.path = &file_paths[alias->second];
+
+            written[alias->second] = true;
+
+            if (!writeRecord(alias->second, linkRecord, out)) {
+                return false;
+                //NOTREACHED
+            }
+        }
+    }
+
+    return true;
+}
+
+bool FileInfoLogger::writeRecord(const size_t taskIdx, FileRecord& record, FileInfoSink& out)
+{
+    //Checked here for all records, so the reused ones get the mark of the current set
+    record.is_known = known_hashes && record.is_correct && !record.digest_type && known_hashes->contains(record.digest);
+    if (record.is_known)
+        known_count++;
+
+    //Failed file is logged with the reason, until there are too many of them
+    if (!record.is_correct && ++failed_count > failure_threshold) {
+        return false;
+        //NOTREACHED
+    }
+
+    //Result is ready, so the worker doesn't touch the digests of its blocks anymore
+    if (block_list.is_open() && record.is_correct) {
+        const std::vector<std::string>& digests = block_digests[link_primary[taskIdx]];
+
+        if (!digests.empty()) {
+            BlockHashList::Entry entry;
+            entry.name = record.shortName();
+            entry.size = static_cast<long long>(record.size);
+            entry.block_size = block_size;
+            entry.digests = digests;
+
+            block_list << BlockHashList::format(entry) << "\n";
+        }
+    }
+
+    if (chunk_list.is_open() && record.is_correct) {
+        const size_t primary = link_primary[taskIdx];
+
+        if (!file_chunks[primary].empty()) {
+            ChunkList::Entry entry;
+            entry.name = record.shortName();
+            entry.size = static_cast<long long>(record.size);
+            entry.chunks = file_chunks[primary];
+
+            chunk_list << ChunkList::format(entry) << "\n";
+        }
+
+        //Chunks of the large tree take a lot of memory, they are kept only for hard links
+        if (primary == taskIdx && !linked_info.count(taskIdx))
+            std::vector<ChunkList::Chunk>().swap(file_chunks[taskIdx]);
+    }
+
+    return out.writeRecord(record);
+}
+
+bool FileInfoLogger::waitResult(const size_t taskIdx, FileRecord& record)
+{
+    const auto pullInterval = std::chrono::milliseconds(_s_pullIntervalMs);
+
+    if (!stall_timeout) {
+        //Files found by the walker meanwhile are queued, so the workers don't run out of them
+        while (!is_walk_finished && results[taskIdx].wait_for(pullInterval) != std::future_status::ready)
+            pullFiles(false);
+
+        record = results[taskIdx].get();
+        return true;
+        //NOTREACHED
+    }
+
+    const auto timeout = std::chrono::seconds(stall_timeout);
+    const auto pollInterval = std::min<std::chrono::milliseconds>(
+        std::chrono::milliseconds(timeout) / 4, std::chrono::milliseconds(250)
+    );
+
+    while (results[taskIdx].wait_for(is_walk_finished ? pollInterval : pullInterval) != std::future_status::ready) {
+        pullFiles(false);
+
+        long long lastActivity = task_states[taskIdx]->progress.last_activity.load(std::memory_order_relaxed);
+
+        //Task is still waiting for a free worker
+        if (!lastActivity)
+            continue;
+
+        auto idle = std::chrono::steady_clock::duration(steadyTicks() - lastActivity);
+        if (idle < timeout)
+            continue;
+
+        record.path         = &file_paths[taskIdx];
+        record.root_dir     = &root_dir;
+        record.error_code   = ETIMEDOUT;
+        record.error_reason = &stall_reason;
+
+        return false;
+        //NOTREACHED
+    }
+
+    record = results[taskIdx].get();
+    return true;
+}
+
+bool FileInfoLogger::waitCompleted(const std::vector<bool>& written, size_t& taskIdx, FileRecord& record)
+{
+    const auto timeout = std::chrono::seconds(stall_timeout);
+    const auto pollInterval = std::min<std::chrono::milliseconds>(
+        std::chrono::milliseconds(timeout) / 4, std::chrono::milliseconds(250)
+    );
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+
+    for (;;) {
+        while (!done_tasks.empty()) {
+            taskIdx = done_tasks.front();
+            done_tasks.pop_front();
+
+            //Hung task that was timed out has finished at last
+            if (taskIdx < written.size() && written[taskIdx])
+                continue;
+
+            lock.unlock();
+
+            //Index is queued just before the result is set
+            record = results[taskIdx].get();
+            return true;
+            //NOTREACHED
+        }
+
+        //Files found by the walker are queued while the workers are busy
+        if (!is_walk_finished) {
+            if (done_cond.wait_for(lock, std::chrono::milliseconds(_s_pullIntervalMs)) == std::cv_status::timeout &&
+                done_tasks.empty()) {
+                lock.unlock();
+                pullFiles(false);
+                lock.lock();
+            }
+
+            if (!stall_timeout)
+                continue;
+        }
+        else if (!stall_timeout) {
+            done_cond.wait(lock);
+            continue;
+        }
+
+        if (done_cond.wait_for(lock, pollInterval) != std::cv_status::timeout || !done_tasks.empty())
+            continue;
+
+        for (size_t i = 0; i < written.size(); i++) {
+            if (written[i] || link_primary[i] != i || !task_states[i])
+                continue;
+
+            long long lastActivity = task_states[i]->progress.last_activity.load(std::memory_order_relaxed);
+
+            //Task is still waiting for a free worker (or its result was reused)
+            if (!lastActivity)
+                continue;
+
+            auto idle = std::chrono::steady_clock::duration(steadyTicks() - lastActivity);
+            if (idle < timeout)
+                continue;
+
+            taskIdx = i;
+            record.path         = &file_paths[i];
+            record.root_dir     = &root_dir;
+            record.error_code   = ETIMEDOUT;
+            record.error_reason = &stall_reason;
+
+            return false;
+            //NOTREACHED
+        }
+    }
+}
+
+void FileInfoLogger::abandonTask(ThreadPool& pool, const size_t taskIdx)
+{
+    TaskState& state = *task_states[taskIdx];
+    std::unique_lock<std::mutex> lock(state.mutex);
+
+    //Result may be set meanwhile, then the timeout is written anyway
+    state.is_abandoned = true;
+
+    //Worker is set before the progress, so it is known for the timed out task
+    pool.abandonWorker(state.worker);
+}
+
+bool FileInfoLogger::loadPreviousLog(PrevInfoMap& prevInfo, std::time_t& prevTime)
+{
+    boost::system::error_code ec;
+
+    prevTime = fs::last_write_time(log_file_path, ec);
+    if (ec) {
+        return false;
+        //NOTREACHED
+    }
+
+    LogReader file;
+    if (!file.open(log_file_path)) {
+        return false;
+        //NOTREACHED
+    }
+
+    std::string line;
+    while (file.getline(line)) {
+        FileInfo finfo;
+        if (!finfo.fromString(line)) {
+            return false;
+            //NOTREACHED
+        }
+
+        //Ambiguous names can't be reused, so force rehashing for them
+        auto inserted = prevInfo.insert(std::make_pair(finfo.short_name, finfo));
+        if (!inserted.second)
+            inserted.first->second.is_correct = false;
+    }
+
+    return !file.is_broken();
+}
+
+bool FileInfoLogger::reusePreviousInfo(const PrevInfoMap& prevInfo, std::time_t prevTime, const size_t taskIdx)
+{
+    auto finded = prevInfo.find(shortName(taskIdx));
+    if (finded == prevInfo.end() || !finded->second.is_correct) {
+        return false;
+        //NOTREACHED
+    }
+
+    const FileInfo& prev = finded->second;
+
+    //Digest of the other type (or with the other sampling) can't be reused
+    if (prev.digest_type != digest_label) {
+        return false;
+        //NOTREACHED
+    }
+
+    const FileStat& stat = file_stats[taskIdx];
+    if (!stat.is_valid) {
+        return false;
+        //NOTREACHED
+    }
+
+    const long long size = static_cast<long long>(stat.size);
+
+    //File was modified after (or during) the previous run
+    if (stat.mtime >= prevTime) {
+        return false;
+        //NOTREACHED
+    }
+
+    if (getHumanReadableSize(size) != prev.human_readable_size ||
+        formatTimeCreation(stat.birth_time) != prev.creation) {
+        return false;
+        //NOTREACHED
+    }
+
+    //Large file is reused only together with the digests of its blocks
+    if (block_size && stat.size > block_size) {
+        auto blocks = prev_blocks.find(prev.short_name);
+        if (blocks == prev_blocks.end()) {
+            return false;
+            //NOTREACHED
+        }
+
+        block_digests[taskIdx] = blocks->second;
+    }
+
+    if (is_chunking && size) {
+        auto chunks = prev_chunks.find(prev.short_name);
+        if (chunks == prev_chunks.end()) {
+            return false;
+            //NOTREACHED
+        }
+
+        file_chunks[taskIdx] = chunks->second;
+    }
+
+    FileRecord record;
+    if (!parseRecord(prev, taskIdx, record)) {
+        return false;
+        //NOTREACHED
+    }
+
+    setReadyResult(taskIdx, record);
+
+    return true;
+}
+
+void FileInfoLogger::loadPreviousBlocks()
+{
+    BlockHashList prevList;
+    if (!prevList.load(block_list_path)) {
+        return;
+        //NOTREACHED
+    }
+
+    const std::vector<BlockHashList::Entry>& entries = prevList.entries();
+
+    //Digests of the other block size are useless
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].block_size == block_size)
+            prev_blocks[entries[i].name] = entries[i].digests;
+    }
+}
+
+void FileInfoLogger::loadPreviousChunks()
+{
+    LogReader file;
+    if (!file.open(chunk_list_path)) {
+        return;
+        //NOTREACHED
+    }
+
+    std::string line;
+    while (file.getline(line)) {
+        ChunkList::Entry entry;
+        if (!ChunkList::parse(line, entry)) {
+            prev_chunks.clear();
+            return;
+            //NOTREACHED
+        }
+
+        prev_chunks[entry.name].swap(entry.chunks);
+    }
+}
+
+void FileInfoLogger::loadJournal(JournalMap& journalInfo)
+{
+    std::ifstream file(journal_path.c_str(), std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+        return;
+        //NOTREACHED
+    }
+
+    //Every record is "<size> <mtime> <name length> <full name><log line>"
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream record(line);
+
+        long long size;
+        long long mtime;
+        size_t nameLen;
+
+        if (!(record >> size >> mtime >> nameLen) || record.get() != ' ') {
+            break;
+            //NOTREACHED
+        }
+
+        std::string fullName(nameLen, 0);
+        if (!nameLen || !record.read(&fullName[0], nameLen)) {
+            break;
+            //NOTREACHED
+        }
+
+        //The last record can be cut by the crash
+        JournalEntry entry;
+        std::string text;
+        if (!std::getline(record, text) || !entry.info.fromString(text)) {
+            break;
+            //NOTREACHED
+        }
+
+        entry.mtime = static_cast<std::time_t>(mtime);
+        entry.info.full_name = fullName;
+        entry.info.size = size;
+
+        journalInfo[fullName] = entry;
+    }
+}
+
+bool FileInfoLogger::reuseJournalInfo(const JournalMap& journalInfo, const size_t taskIdx)
+{
+    fs::path& cpath = file_paths[taskIdx];
+
+    auto finded = journalInfo.find(cpath.string());
+    if (finded == journalInfo.end() ||
+        finded->second.info.digest_type != digest_label) {
+        return false;
+        //NOTREACHED
+    }
+
+    const FileStat& stat = file_stats[taskIdx];
+    if (!stat.is_valid || static_cast<long long>(stat.size) != finded->second.info.size) {
+        return false;
+        //NOTREACHED
+    }
+
+    //Block digests and chunks are not journaled
+    if ((block_size && stat.size > block_size) || (is_chunking && stat.size)) {
+        return false;
+        //NOTREACHED
+    }
+
+    if (stat.mtime != finded->second.mtime) {
+        return false;
+        //NOTREACHED
+    }
+
+    FileRecord record;
+    if (!parseRecord(finded->second.info, taskIdx, record)) {
+        return false;
+        //NOTREACHED
+    }
+
+    setReadyResult(taskIdx, record);
+
+    return true;
+}
+
+void FileInfoLogger::appendToJournal(const FileRecord& record, std::time_t mtime)
+{
+    const std::string fullName = record.path->string();
+
+    std::ostringstream text;
+    text << record.size << ' ' << static_cast<long long>(mtime) << ' '
+         << fullName.size() << ' ' << fullName << record.toString();
+
+    std::unique_lock<std::mutex> lock(journal_mutex);
+
+    if (!journal.is_open()) {
+        return;
+        //NOTREACHED
+    }
+
+    journal << text.str();
+
+    //Flush from time to time, it is enough to lose only a few records
+    auto now = std::chrono::steady_clock::now();
+    if (++journal_pending >= _s_journalFlushRecords ||
+        now - journal_flush_time >= std::chrono::seconds(_s_journalFlushInterval)) {
+        journal.flush();
+        journal_pending = 0;
+        journal_flush_time = now;
+    }
+}
+
+bool FileInfoLogger::isLinkOfHashedFile(std::map<FileIdentity, size_t>& hashedFiles, const size_t taskIdx)
+{
+    const FileStat& stat = file_stats[taskIdx];
+
+    //Only files with several links can share the data (the count isn't a part of
+    //the identity, a link may be added or removed while the tree is logged)
+    if (!stat.is_valid || stat.links < 2) {
+        return false;
+        //NOTREACHED
+    }
+
+    FileIdentity identity;
+    identity.device = stat.device;
+    identity.inode  = stat.inode;
+
+    //Result of the first link is kept for the links that are found later
+    auto inserted = hashedFiles.insert(std::make_pair(identity, taskIdx));
+    if (inserted.second) {
+        linked_info[taskIdx] = FileRecord();
+        return false;
+        //NOTREACHED
+    }
+
+    //Paths are sorted, so the first link is always written before this one
+    link_primary[taskIdx] = inserted.first->second;
+
+    return true;
+}
+
+bool FileInfoLogger::parseRecord(const FileInfo& finfo, const size_t taskIdx, FileRecord& record) const
+{
+    if (!parseMD5(finfo.checksum.c_str(), record.digest)) {
+        return false;
+        //NOTREACHED
+    }
+
+    //Size and creation time of the reused text are checked against the snapshot
+    const FileStat& stat = file_stats[taskIdx];
+
+    record.path          = &file_paths[taskIdx];
+    record.root_dir      = &root_dir;
+    record.digest_type   = is_fingerprint ? &digest_label : NULL;
+    record.size          = stat.size;
+    record.creation_time = static_cast<long long>(stat.birth_time);
+    record.is_correct    = true;
+
+    return true;
+}
+
+void FileInfoLogger::setReadyResult(const size_t taskIdx, const FileRecord& record)
+{
+    std::promise<FileRecord> ready;
+    ready.set_value(record);
+    results[taskIdx] = ready.get_future();
+
+    if (is_completion_order)
+        notifyCompleted(taskIdx);
+}
+
+FileRecord FileInfoLogger::infoExtractorWrapper(const size_t idx, const TaskSlots& slots,
+                                                const std::shared_ptr<TaskState>& state)
+{
+    //Only the state is touched till the logger takes the result, the worker may be abandoned
+    TaskState& task = *state;
+
+    ExtractProgress *taskProgress = task.is_watched ? &task.progress : NULL;
+
+    if (taskProgress) {
+        std::unique_lock<std::mutex> lock(task.mutex);
+        task.worker = std::this_thread::get_id();
+    }
+
+    //Deadline counts from the moment the worker takes the file
+    if (taskProgress && task.file_deadline) {
+        taskProgress->deadline = steadyTicks() +
+            std::chrono::steady_clock::duration(std::chrono::seconds(task.file_deadline)).count();
+    }
+
+    std::unique_ptr<ContentChunker> chunker;
+    if (task.is_chunking)
+        chunker.reset(new ContentChunker(task.chunks));
+
+    //Stat is taken before hashing, so a file changed during it is not trusted on resume
+    FileRecord retVal = FileRecordExtract(
+        task.path, taskProgress, task.block_size, task.block_size ? &task.block_digests : NULL,
+        chunker.get(), task.is_fingerprint ? &task.fingerprint_spec : NULL, &task.stat
+    );
+
+    chunker.reset();
+
+    std::unique_lock<std::mutex> lock(task.mutex);
+
+    //Timeout is written instead of the result, and the logger may be gone already
+    if (task.is_abandoned) {
+        return (retVal);
+        //NOTREACHED
+    }
+
+    if (slots.block_digests)
+        slots.block_digests->swap(task.block_digests);
+
+    if (slots.chunks)
+        slots.chunks->swap(task.chunks);
+
+    //Name is made relative to the root when the record is written
+    retVal.path = slots.path;
+    retVal.root_dir = &root_dir;
+    if (is_fingerprint)
+        retVal.digest_type = &digest_label;
+
+    if (is_checkpointing && task.stat.is_valid && retVal.is_correct)
+        appendToJournal(retVal, task.stat.mtime);
+
+    if (is_completion_order)
+        notifyCompleted(idx);
+
+    return (retVal);
+}
+
+void FileInfoLogger::notifyCompleted(const size_t taskIdx)
+{
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_tasks.push_back(taskIdx);
+    done_cond.notify_one();
+}
+
+std::string FileInfoLogger::shortName(const size_t taskIdx) const
+{
+    return FileRecord::nameOf(root_dir, file_paths[taskIdx]);
+}
+
+//
+//
+//
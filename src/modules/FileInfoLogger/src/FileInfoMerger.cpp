@@ -0,0 +1,170 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileInfoMerger.cpp    (V. Drozd)
+// src/modules/FileInfoLogger/src/FileInfoMerger.cpp
+//
+
+//
+// Combines partial logs of the sharded run into the final log
+//
+
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "CalculateSum/FileInfoMerger.h"
+#include "LogReader.h"
+
+#include <algorithm>
+#include <ctime>
+#include <functional>
+#include <queue>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: public function member definitions
+//
+
+FileInfoMerger::FileInfoMerger(const std::vector<fs::path>& partPaths, const fs::path& logFilePath)
+    : part_paths(partPaths)
+    , log_file_path(logFilePath)
+    , record_count(0)
+    , is_broken(false)
+{
+}
+
+bool FileInfoMerger::process()
+{
+    record_count = 0;
+    is_broken = false;
+
+    std::vector<Cursor> cursors(part_paths.size());
+    std::time_t oldestTime = 0;
+
+    for (size_t i = 0; i < part_paths.size(); i++) {
+        boost::system::error_code ec;
+
+        //Files changed after the oldest part was started must be rehashed by the update
+        std::time_t time = fs::last_write_time(part_paths[i], ec);
+        if (ec) {
+            return false;
+            //NOTREACHED
+        }
+
+        if (!i || time < oldestTime)
+            oldestTime = time;
+
+        cursors[i].in.reset(new LogReader());
+        if (!cursors[i].in->open(part_paths[i])) {
+            return false;
+            //NOTREACHED
+        }
+    }
+
+    //The smallest name is on the top
+    auto greater = [&cursors](size_t a, size_t b) {
+        return cursors[b].name.compare(cursors[a].name) < 0;
+    };
+    std::priority_queue<size_t, std::vector<size_t>, std::function<bool(size_t, size_t)>> heads(greater);
+
+    for (size_t i = 0; i < cursors.size(); i++) {
+        if (advance(cursors[i]))
+            heads.push(i);
+    }
+
+    std::ofstream file(log_file_path.c_str(), std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+        //NOTREACHED
+    }
+
+    fs::path lastName;
+
+    while (!heads.empty() && !is_broken) {
+        size_t idx = heads.top();
+        heads.pop();
+
+        //Shards don't intersect, so it is the wrong set of parts
+        if (record_count && !cursors[idx].name.compare(lastName)) {
+            is_broken = true;
+            break;
+        }
+
+        file << cursors[idx].line << "\n";
+        record_count++;
+        lastName = cursors[idx].name;
+
+        if (advance(cursors[idx]))
+            heads.push(idx);
+    }
+
+    file.close();
+    if (file.fail() || is_broken) {
+        return false;
+        //NOTREACHED
+    }
+
+    boost::system::error_code ec;
+    fs::last_write_time(log_file_path, oldestTime, ec);
+
+    return true;
+}
+
+size_t FileInfoMerger::recordCount() const
+{
+    return record_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: private function member definitions
+//
+
+bool FileInfoMerger::advance(Cursor& cursor)
+{
+    std::string line;
+
+    if (!cursor.in->getline(line)) {
+        is_broken = is_broken || cursor.in->is_broken();
+        return false;
+        //NOTREACHED
+    }
+
+    if (!line.empty() && line.back() == '\r')
+        line.erase(line.end() - 1);
+
+    FileInfo finfo;
+    if (!finfo.fromString(line) || finfo.short_name.empty()) {
+        is_broken = true;
+        return false;
+        //NOTREACHED
+    }
+
+    fs::path name(finfo.short_name);
+
+    //Every part must be sorted for the merge
+    if (!cursor.line.empty() && name.compare(cursor.name) <= 0) {
+        is_broken = true;
+        return false;
+        //NOTREACHED
+    }
+
+    cursor.line.swap(line);
+    cursor.name.swap(name);
+
+    return true;
+}
+
+//
+//
+//
@@ -0,0 +1,422 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileInfoSink.cpp    (V. Drozd)
+// src/modules/FileInfoLogger/src/FileInfoSink.cpp
+//
+
+//
+// Built-in destinations of the records calculated by FileInfoLogger
+//
+
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "CalculateSum/FileInfoSink.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <zlib.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: variable definitions
+//
+
+//Lines are passed to the compression thread by blocks of this size
+static const size_t _s_gzipBlockSize  = 256 * 1024;
+
+//Writer waits when so many blocks are not compressed yet
+static const size_t _s_gzipQueueLimit = 8;
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local declarations
+//
+
+//
+// Quote the string for JSON, control characters are escaped
+//
+
+static std::string _t_json_string(const std::string& text);
+
+//
+// Quote the field for CSV if it is needed
+//
+
+static std::string _t_csv_field(const std::string& text);
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: file sink definitions
+//
+
+FileSink::FileSink(const fs::path& filePath)
+    : file_path(filePath)
+{
+}
+
+const fs::path& FileSink::path() const
+{
+    return file_path;
+}
+
+bool FileSink::open()
+{
+    file.open(file_path.c_str(), std::ios::out | std::ios::trunc);
+    return file.is_open();
+}
+
+bool FileSink::close()
+{
+    file.close();
+    return !file.fail();
+}
+
+TextLogSink::TextLogSink(const fs::path& filePath)
+    : FileSink(filePath)
+{
+}
+
+bool TextLogSink::write(const FileInfo& finfo)
+{
+    file << FileInfo(finfo).toString();
+    return !file.fail();
+}
+
+bool TextLogSink::writeRecord(const FileRecord& record)
+{
+    file << record.toString();
+    return !file.fail();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: gzip sink definitions
+//
+
+struct GzipLogSink::Pipeline {
+    gzFile                  file;
+    std::thread             thread;
+
+    std::mutex              mutex;
+    std::condition_variable cond;
+    std::deque<std::string> blocks;
+    bool                    is_finished;
+    bool                    is_failed;
+
+    Pipeline(gzFile gzfile)
+        : file(gzfile)
+        , is_finished(false)
+        , is_failed(false)
+    {
+        thread = std::thread([this]() { compress(); });
+    }
+
+    ~Pipeline()
+    {
+        finish();
+
+        if (file)
+            gzclose(file);
+    }
+
+    void compress()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        for (;;) {
+            cond.wait(lock, [this]() { return !blocks.empty() || is_finished; });
+
+            if (blocks.empty()) {
+                break;
+                //NOTREACHED
+            }
+
+            std::string data;
+            data.swap(blocks.front());
+            blocks.pop_front();
+
+            //Writer may go on while the block is compressed
+            cond.notify_all();
+            lock.unlock();
+
+            bool isWritten = !is_failed &&
+                gzwrite(file, data.data(), static_cast<unsigned int>(data.size())) == static_cast<int>(data.size());
+
+            lock.lock();
+            if (!isWritten)
+                is_failed = true;
+        }
+    }
+
+    bool push(std::string& data)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this]() { return blocks.size() < _s_gzipQueueLimit || is_failed; });
+
+        if (is_failed) {
+            return false;
+            //NOTREACHED
+        }
+
+        blocks.push_back(std::string());
+        blocks.back().swap(data);
+        cond.notify_all();
+
+        return true;
+    }
+
+    void finish()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            is_finished = true;
+            cond.notify_all();
+        }
+
+        if (thread.joinable())
+            thread.join();
+    }
+};
+
+GzipLogSink::GzipLogSink(const fs::path& filePath, int level)
+    : file_path(filePath)
+    , level(std::min(9, std::max(1, level)))
+{
+}
+
+GzipLogSink::~GzipLogSink()
+{
+}
+
+bool GzipLogSink::open()
+{
+    pipeline.reset();
+
+    const std::string mode = "wb" + std::to_string(level);
+
+#ifdef _WIN32
+    gzFile file = gzopen_w(file_path.c_str(), mode.c_str());
+#else
+    gzFile file = gzopen(file_path.c_str(), mode.c_str());
+#endif
+    if (!file) {
+        return false;
+        //NOTREACHED
+    }
+
+    gzbuffer(file, _s_gzipBlockSize);
+
+    block.clear();
+    block.reserve(_s_gzipBlockSize + 4096);
+    pipeline.reset(new Pipeline(file));
+
+    return true;
+}
+
+bool GzipLogSink::write(const FileInfo& finfo)
+{
+    return writeLine(FileInfo(finfo).toString());
+}
+
+bool GzipLogSink::writeRecord(const FileRecord& record)
+{
+    return writeLine(record.toString());
+}
+
+bool GzipLogSink::close()
+{
+    if (!pipeline) {
+        return false;
+        //NOTREACHED
+    }
+
+    bool retVal = block.empty() || flushBlock();
+
+    pipeline->finish();
+    retVal = retVal && !pipeline->is_failed;
+
+    //Trailer is written by gzclose()
+    retVal = (Z_OK == gzclose(pipeline->file)) && retVal;
+    pipeline->file = NULL;
+    pipeline.reset();
+
+    return (retVal);
+}
+
+bool GzipLogSink::writeLine(const std::string& line)
+{
+    block += line;
+
+    if (block.size() < _s_gzipBlockSize) {
+        return true;
+        //NOTREACHED
+    }
+
+    return flushBlock();
+}
+
+bool GzipLogSink::flushBlock()
+{
+    if (!pipeline->push(block)) {
+        return false;
+        //NOTREACHED
+    }
+
+    block.clear();
+    block.reserve(_s_gzipBlockSize + 4096);
+
+    return true;
+}
+
+JsonLinesSink::JsonLinesSink(const fs::path& filePath)
+    : FileSink(filePath)
+{
+}
+
+bool JsonLinesSink::write(const FileInfo& finfo)
+{
+    file << "{\"name\":" << _t_json_string(finfo.short_name);
+
+    if (finfo.is_correct) {
+        file << ",\"size\":" << finfo.size
+             << ",\"created\":" << _t_json_string(finfo.creation)
+             << ",\"known\":" << (finfo.is_known ? "true" : "false");
+
+        //Fingerprint is labeled by its parameters
+        if (finfo.digest_type.empty()) {
+            file << ",\"md5\":" << _t_json_string(finfo.checksum);
+        }
+        else {
+            file << ",\"fingerprint\":" << _t_json_string(finfo.checksum)
+                 << ",\"type\":" << _t_json_string(finfo.digest_type);
+        }
+    }
+    else {
+        file << ",\"error\":" << finfo.error_code
+             << ",\"reason\":" << _t_json_string(finfo.error_reason);
+    }
+
+    file << "}\n";
+    return !file.fail();
+}
+
+CsvSink::CsvSink(const fs::path& filePath)
+    : FileSink(filePath)
+{
+}
+
+bool CsvSink::open()
+{
+    if (!FileSink::open()) {
+        return false;
+        //NOTREACHED
+    }
+
+    file << "name,size,created,digest,type,known,error,reason\n";
+    return !file.fail();
+}
+
+bool CsvSink::write(const FileInfo& finfo)
+{
+    file << _t_csv_field(finfo.short_name) << ",";
+
+    if (finfo.is_correct) {
+        file << finfo.size << "," << _t_csv_field(finfo.creation) << ","
+             << finfo.checksum << "," << (finfo.digest_type.empty() ? "MD5" : _t_csv_field(finfo.digest_type)) << ","
+             << (finfo.is_known ? "1" : "0") << ",,";
+    }
+    else {
+        file << ",,,,," << finfo.error_code << "," << _t_csv_field(finfo.error_reason);
+    }
+
+    file << "\n";
+    return !file.fail();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: vector sink definitions
+//
+
+bool VectorSink::open()
+{
+    record_list.clear();
+    return true;
+}
+
+bool VectorSink::write(const FileInfo& finfo)
+{
+    record_list.push_back(finfo);
+    return true;
+}
+
+const std::vector<FileInfo>& VectorSink::records() const
+{
+    return record_list;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local definitions
+//
+
+static std::string _t_json_string(const std::string& text)
+{
+    std::string retVal(1, '"');
+
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+
+        if (c == '"' || c == '\\') {
+            retVal += '\\';
+            retVal += c;
+        }
+        else if (c < 0x20) {
+            char escaped[8];
+            std::sprintf(escaped, "\\u%04x", c);
+            retVal += escaped;
+        }
+        else {
+            retVal += c;
+        }
+    }
+
+    retVal += '"';
+    return (retVal);
+}
+
+static std::string _t_csv_field(const std::string& text)
+{
+    if (text.find_first_of(",\"\r\n") == std::string::npos) {
+        return text;
+        //NOTREACHED
+    }
+
+    std::string retVal(1, '"');
+
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '"')
+            retVal += '"';
+        retVal += text[i];
+    }
+
+    retVal += '"';
+    return (retVal);
+}
+
+//
+//
+//
@@ -0,0 +1,271 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileInfoVerifier.cpp    (V. Drozd)
+// src/modules/FileInfoLogger/src/FileInfoVerifier.cpp
+//
+
+//
+// Checks files of the directory against the known-good log (manifest)
+//
+
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "CalculateSum/FileInfoVerifier.h"
+#include "FileInfoExtractor.h"
+#include "LogReader.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: public function member definitions
+//
+
+FileInfoVerifier::FileInfoVerifier(const fs::path& manifestPath, const fs::path& workDir)
+    : manifest_path(manifestPath)
+    , work_dir(workDir)
+    , is_fail_fast(false)
+    , matched_count(0)
+    , mismatched_count(0)
+    , missing_count(0)
+    , failed_count(0)
+{
+}
+
+void FileInfoVerifier::setFailFast(bool enable)
+{
+    is_fail_fast = enable;
+}
+
+bool FileInfoVerifier::process(std::ostream& out)
+{
+    matched_count = mismatched_count = missing_count = failed_count = 0;
+    done.clear();
+
+    if (!loadManifest()) {
+        return false;
+        //NOTREACHED
+    }
+
+    //Create thread pool with optimal size for logger
+    ThreadPool pool(std::max(1U, std::thread::hardware_concurrency() - 1));
+
+    size_t pending = 0;
+    bool isStopped = false;
+
+    for (size_t i = 0; i < file_paths.size() && !isStopped; i++) {
+        Outcome outcome;
+
+        //Missing and resized files are reported without reading them
+        if (checkSize(i, outcome)) {
+            isStopped = !report(out, outcome);
+            continue;
+        }
+
+        fs::path *cpath = &file_paths[i];
+        pool.addTask([this, cpath, i]() { verifyTask(*cpath, i); });
+        pending++;
+    }
+
+    //Report every file as soon as its worker is finished
+    while (pending && !isStopped) {
+        Outcome outcome;
+        {
+            std::unique_lock<std::mutex> lock(done_mutex);
+
+            while (done.empty())
+                done_condition.wait(lock);
+
+            outcome = done.front();
+            done.pop_front();
+        }
+
+        pending--;
+        isStopped = !report(out, outcome);
+    }
+
+    //Files that are not started yet are not needed anymore,
+    //and the running ones are finished by the pool destructor
+    if (isStopped)
+        pool.clearTaskQueue();
+
+    out.flush();
+
+    return true;
+}
+
+size_t FileInfoVerifier::matchedCount() const
+{
+    return matched_count;
+}
+
+size_t FileInfoVerifier::mismatchedCount() const
+{
+    return mismatched_count;
+}
+
+size_t FileInfoVerifier::missingCount() const
+{
+    return missing_count;
+}
+
+size_t FileInfoVerifier::failedCount() const
+{
+    return failed_count;
+}
+
+bool FileInfoVerifier::isIntact() const
+{
+    return (!mismatched_count && !missing_count && !failed_count);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: private function member definitions
+//
+
+bool FileInfoVerifier::loadManifest()
+{
+    expected.clear();
+    file_paths.clear();
+
+    LogReader file;
+    if (!file.open(manifest_path)) {
+        return false;
+        //NOTREACHED
+    }
+
+    std::string line;
+    while (file.getline(line)) {
+        FileInfo finfo;
+        if (!finfo.fromString(line)) {
+            return false;
+            //NOTREACHED
+        }
+
+        //File that was failed when the manifest was made has nothing to compare with
+        if (!finfo.is_correct)
+            continue;
+
+        fs::path cpath = work_dir / finfo.short_name;
+        finfo.full_name = cpath.string();
+
+        file_paths.push_back(cpath);
+        expected.push_back(finfo);
+    }
+
+    return !file.is_broken();
+}
+
+bool FileInfoVerifier::checkSize(const size_t idx, Outcome& outcome) const
+{
+    boost::system::error_code ec;
+
+    outcome.idx = idx;
+    outcome.info = expected[idx];
+
+    if (!fs::is_regular_file(file_paths[idx], ec)) {
+        outcome.status = MISSING;
+        return true;
+        //NOTREACHED
+    }
+
+    //Leave the reason of the failure to the worker
+    auto size = fs::file_size(file_paths[idx], ec);
+    if (ec) {
+        return false;
+        //NOTREACHED
+    }
+
+    //Manifest keeps the size only in the human readable form, but it is enough
+    //to tell that the file is changed
+    if (getHumanReadableSize(size) != expected[idx].human_readable_size) {
+        outcome.status = MISMATCHED;
+        return true;
+        //NOTREACHED
+    }
+
+    return false;
+}
+
+void FileInfoVerifier::verifyTask(fs::path& fpath, const size_t idx)
+{
+    Outcome outcome;
+    outcome.idx = idx;
+
+    //Fingerprint is checked with the sampling it was made with
+    FingerprintSpec spec;
+    bool isFingerprint = !expected[idx].digest_type.empty();
+
+    if (isFingerprint && !spec.fromLabel(expected[idx].digest_type)) {
+        outcome.info.short_name = expected[idx].short_name;
+        outcome.info.error_code = EINVAL;
+        outcome.info.error_reason = "unknown digest type " + expected[idx].digest_type;
+    }
+    else {
+        outcome.info = FileInfoExtract(fpath, NULL, 0, NULL, NULL, isFingerprint ? &spec : NULL);
+    }
+
+    if (!outcome.info.is_correct)
+        outcome.status = FAILED;
+    else if (outcome.info.checksum != expected[idx].checksum)
+        outcome.status = MISMATCHED;
+    else
+        outcome.status = MATCHED;
+
+    {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done.push_back(outcome);
+    }
+
+    done_condition.notify_one();
+}
+
+bool FileInfoVerifier::report(std::ostream& out, const Outcome& outcome)
+{
+    const std::string& name = expected[outcome.idx].short_name;
+
+    switch (outcome.status) {
+    case MATCHED:
+        matched_count++;
+        return true;
+        //NOTREACHED
+
+    case MISMATCHED:
+        mismatched_count++;
+        out << "MISMATCH " << name << std::endl;
+        break;
+
+    case MISSING:
+        missing_count++;
+        out << "MISSING " << name << std::endl;
+        break;
+
+    case FAILED:
+        failed_count++;
+        out << "ERROR " << FileInfo(outcome.info).toString() << std::flush;
+        break;
+    }
+
+    return !is_fail_fast;
+}
+
+//
+//
+//
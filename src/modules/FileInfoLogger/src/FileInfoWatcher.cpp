@@ -0,0 +1,650 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileInfoWatcher.cpp    (V. Drozd)
+// src/modules/FileInfoLogger/src/FileInfoWatcher.cpp
+//
+
+//
+// Keeps the log of the directory up to date by watching filesystem events
+//
+
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "CalculateSum/FileInfoWatcher.h"
+#include "CalculateSum/FileInfoLogger.h"
+#include "CalculateSum/DirectoryWalker.h"
+#include "FileInfoExtractor.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <sys/inotify.h>
+# include <poll.h>
+# include <unistd.h>
+# include <errno.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: variable definitions
+//
+
+//How often the waiting for events is interrupted to check stop request
+static const unsigned int _s_stopCheckInterval = 1000;
+
+//Continuously changing files must not delay the log forever
+static const unsigned int _s_maxDebounceFactor = 10;
+
+static const unsigned int _s_defaultDebounceInterval = 500;
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local declarations
+//
+
+//
+// Path is the directory itself or is inside of it
+//
+
+static bool _t_is_within(const fs::path& dirPath, const fs::path& filePath);
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: event sources
+//
+
+#ifdef _WIN32
+
+struct FileInfoWatcher::EventSource {
+    HANDLE      dir;
+    OVERLAPPED  overlapped;
+    bool        is_pending;
+    DWORD       buffer[16 * 1024];
+
+    BOOL        is_subtree;
+
+    EventSource(const fs::path& workDir, bool recursive)
+        : is_pending(false)
+        , is_subtree(recursive ? TRUE : FALSE)
+    {
+        dir = CreateFileW(
+            workDir.c_str(), FILE_LIST_DIRECTORY,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+            OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL
+        );
+
+        ZeroMemory(&overlapped, sizeof(overlapped));
+        overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    }
+
+    ~EventSource()
+    {
+        if (is_pending) {
+            DWORD bytes;
+            CancelIo(dir);
+            GetOverlappedResult(dir, &overlapped, &bytes, TRUE);
+        }
+
+        if (overlapped.hEvent)
+            CloseHandle(overlapped.hEvent);
+
+        if (dir != INVALID_HANDLE_VALUE)
+            CloseHandle(dir);
+    }
+
+    bool isOpen() const
+    {
+        return (dir != INVALID_HANDLE_VALUE && overlapped.hEvent);
+    }
+
+    //Subdirectories are watched with the directory
+    bool addDir(const fs::path&)
+    {
+        return true;
+    }
+
+    //return number of events, 0 on timeout and -1 on error
+    int read(std::set<fs::path>& names, bool& overflow, unsigned int timeout)
+    {
+        static const DWORD filter =
+            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_SIZE |
+            FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_CREATION;
+
+        if (!is_pending) {
+            if (!ReadDirectoryChangesW(dir, buffer, sizeof(buffer), is_subtree, filter, NULL, &overlapped, NULL)) {
+                return -1;
+                //NOTREACHED
+            }
+            is_pending = true;
+        }
+
+        DWORD rc = WaitForSingleObject(overlapped.hEvent, timeout);
+        if (WAIT_TIMEOUT == rc) {
+            return 0;
+            //NOTREACHED
+        }
+
+        is_pending = false;
+
+        DWORD bytes = 0;
+        if (WAIT_OBJECT_0 != rc || !GetOverlappedResult(dir, &overlapped, &bytes, FALSE)) {
+            return -1;
+            //NOTREACHED
+        }
+        ResetEvent(overlapped.hEvent);
+
+        //Too many changes for the buffer, the system dropped them
+        if (!bytes) {
+            overflow = true;
+            return 1;
+            //NOTREACHED
+        }
+
+        int count = 0;
+        const char *pos = reinterpret_cast<const char *>(buffer);
+
+        for (;;) {
+            const FILE_NOTIFY_INFORMATION *info = reinterpret_cast<const FILE_NOTIFY_INFORMATION *>(pos);
+
+            names.insert(fs::path(std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR))));
+            count++;
+
+            if (!info->NextEntryOffset)
+                break;
+            pos += info->NextEntryOffset;
+        }
+
+        return count;
+    }
+};
+
+#else
+
+struct FileInfoWatcher::EventSource {
+    int                     fd;
+    int                     wd;    //of the working directory
+    fs::path                root;
+
+    //Relative paths of the watched directories
+    std::map<int, fs::path> dirs;
+
+    EventSource(const fs::path& workDir, bool)
+        : wd(-1)
+        , root(workDir)
+    {
+        fd = inotify_init1(IN_CLOEXEC);
+        if (fd >= 0 && addDir(fs::path()))
+            wd = dirs.begin()->first;
+    }
+
+    ~EventSource()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool isOpen() const
+    {
+        return (fd >= 0 && wd >= 0);
+    }
+
+    //Directory that is watched already keeps its descriptor, only its path is updated
+    bool addDir(const fs::path& relPath)
+    {
+        static const uint32_t mask =
+            IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+            IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+        int dirWd = inotify_add_watch(fd, (relPath.empty() ? root : root / relPath).c_str(), mask);
+        if (dirWd < 0) {
+            return false;
+            //NOTREACHED
+        }
+
+        dirs[dirWd] = relPath;
+        return true;
+    }
+
+    //return number of events, 0 on timeout and -1 on error
+    int read(std::set<fs::path>& names, bool& overflow, unsigned int timeout)
+    {
+        pollfd pfd = { fd, POLLIN, 0 };
+
+        int rc = poll(&pfd, 1, static_cast<int>(timeout));
+        if (rc <= 0) {
+            return (rc < 0 && errno != EINTR) ? -1 : 0;
+            //NOTREACHED
+        }
+
+        alignas(inotify_event) char buffer[64 * 1024];
+
+        ssize_t len = ::read(fd, buffer, sizeof(buffer));
+        if (len <= 0) {
+            return (len < 0 && errno != EINTR) ? -1 : 0;
+            //NOTREACHED
+        }
+
+        int count = 0;
+
+        for (const char *pos = buffer; pos < buffer + len; count++) {
+            const inotify_event *ev = reinterpret_cast<const inotify_event *>(pos);
+            pos += sizeof(inotify_event) + ev->len;
+
+            //Working directory itself was removed or moved away
+            if (ev->wd == wd && (ev->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF))) {
+                return -1;
+                //NOTREACHED
+            }
+
+            //Subdirectory is gone, its entry in the parent is reported as well
+            if (ev->mask & IN_IGNORED) {
+                dirs.erase(ev->wd);
+                continue;
+            }
+
+            auto dir = dirs.find(ev->wd);
+
+            if (ev->mask & IN_Q_OVERFLOW)
+                overflow = true;
+            else if (ev->len && dir != dirs.end())
+                names.insert(dir->second / ev->name);
+        }
+
+        return count;
+    }
+};
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: public function member definitions
+//
+
+FileInfoWatcher::FileInfoWatcher(const fs::path& workDir, const fs::path& logFilePath)
+    : work_dir(workDir)
+    , log_file_path(logFilePath)
+    , tmp_log_file_path(logFilePath.string() + ".tmp")
+    , debounce_interval(_s_defaultDebounceInterval)
+    , is_recursive(false)
+    , is_stopped(false)
+{
+}
+
+FileInfoWatcher::~FileInfoWatcher()
+{
+}
+
+void FileInfoWatcher::setDebounceInterval(unsigned int milliseconds)
+{
+    debounce_interval = milliseconds;
+}
+
+void FileInfoWatcher::setRecursive(bool enable)
+{
+    is_recursive = enable;
+}
+
+void FileInfoWatcher::setFilterSpec(const FileFilterSpec& spec)
+{
+    filter_spec = spec;
+}
+
+bool FileInfoWatcher::run()
+{
+    //Start watching before the scan, so changes made during it are not lost
+    events.reset(new EventSource(work_dir, is_recursive));
+    if (!events->isOpen()) {
+        return false;
+        //NOTREACHED
+    }
+
+    if (!initialScan()) {
+        return false;
+        //NOTREACHED
+    }
+
+    //Create thread pool with optimal size for logger
+    ThreadPool pool(std::max(1U, std::thread::hardware_concurrency() - 1));
+
+    while (!is_stopped) {
+        std::set<fs::path> changedNames;
+        bool overflow = false;
+
+        if (!waitEvents(changedNames, overflow)) {
+            return false;
+            //NOTREACHED
+        }
+
+        //Some events are lost, so nothing is known about the directory
+        if (overflow) {
+            if (!initialScan()) {
+                return false;
+                //NOTREACHED
+            }
+            continue;
+        }
+
+        if (changedNames.empty())
+            continue;
+
+        //Files of the new subtree are found by the rescan, which watches it too
+        if (!updateEntries(pool, changedNames)) {
+            if (!initialScan()) {
+                return false;
+                //NOTREACHED
+            }
+            continue;
+        }
+
+        if (!writeLog()) {
+            return false;
+            //NOTREACHED
+        }
+    }
+
+    return true;
+}
+
+void FileInfoWatcher::stop()
+{
+    is_stopped = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: private function member definitions
+//
+
+bool FileInfoWatcher::initialScan()
+{
+    //Directories are watched before they are read, so changes made during the scan are not lost
+    if (is_recursive && !watchTree()) {
+        return false;
+        //NOTREACHED
+    }
+
+    FileFilterSpec spec(filter_spec);
+    if (!is_recursive)
+        spec.setMaxDepth(1);
+
+    //The same walk as of the normal run, so the log is the same too. The log itself
+    //is skipped by the logger, the temporary file is left only by the crash
+    DirectoryWalker walker(work_dir);
+    walker.setFilterSpec(spec);
+    walker.setFileFilter([this](const fs::path& thisPath) -> bool {
+        boost::system::error_code ec;
+        return (thisPath.filename() != tmp_log_file_path.filename() || !fs::equivalent(thisPath, tmp_log_file_path, ec));
+    });
+
+    std::vector<fs::path> fileList;
+    std::unique_ptr<FileInfoLogger> logger;
+
+    if (is_recursive) {
+        logger.reset(new FileInfoLogger(walker, log_file_path));
+    }
+    else {
+        if (!walker.process()) {
+            return false;
+            //NOTREACHED
+        }
+
+        fileList = walker.files();
+        logger.reset(new FileInfoLogger(fileList, log_file_path));
+    }
+
+    //Unchanged files are not rehashed if the log was made before
+    logger->setIncrementalUpdate(true);
+
+    if (!logger->process()) {
+        return false;
+        //NOTREACHED
+    }
+
+    //And the log becomes the initial state
+    std::ifstream file(log_file_path.c_str());
+    if (!file.is_open()) {
+        return false;
+        //NOTREACHED
+    }
+
+    entries.clear();
+
+    std::string line;
+    while (std::getline(file, line)) {
+        FileInfo finfo;
+        if (!finfo.fromString(line)) {
+            return false;
+            //NOTREACHED
+        }
+
+        //Names of the log are '/' separated, the events use the native separator
+        fs::path cpath = work_dir / fs::path(finfo.short_name).make_preferred();
+        finfo.full_name = cpath.string();
+        entries[cpath] = finfo;
+    }
+
+    return true;
+}
+
+bool FileInfoWatcher::watchTree()
+{
+    //Relative path and depth of the directories to watch, excluded subtrees are not watched
+    std::vector<std::pair<fs::path, size_t>> dirs(1, std::make_pair(fs::path(), size_t(0)));
+
+    while (!dirs.empty()) {
+        const std::pair<fs::path, size_t> dir = dirs.back();
+        dirs.pop_back();
+
+        if (!events->addDir(dir.first)) {
+            return false;
+            //NOTREACHED
+        }
+
+        //Unreadable subdirectory is skipped, as by the walker
+        std::vector<fs::path> files;
+        std::vector<fs::path> subdirs;
+        boost::system::error_code ec;
+        DirectoryWalker::listDir(dir.first.empty() ? work_dir : work_dir / dir.first, files, &subdirs, ec);
+
+        for (size_t i = 0; i < subdirs.size(); i++) {
+            const fs::path relPath = dir.first / subdirs[i].filename();
+
+            if (filter_spec.isDirIncluded(relPath.generic_string(), dir.second + 1))
+                dirs.push_back(std::make_pair(relPath, dir.second + 1));
+        }
+    }
+
+    return true;
+}
+
+bool FileInfoWatcher::waitEvents(std::set<fs::path>& changedNames, bool& overflow)
+{
+    int count = 0;
+
+    //Wait for the first event
+    while (!count) {
+        if (is_stopped) {
+            return true;
+            //NOTREACHED
+        }
+
+        count = readEvents(changedNames, overflow, _s_stopCheckInterval);
+        if (count < 0) {
+            return false;
+            //NOTREACHED
+        }
+    }
+
+    //And coalesce all the following ones until the directory calms down
+    auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(debounce_interval * _s_maxDebounceFactor);
+
+    while (count > 0 && !is_stopped && std::chrono::steady_clock::now() < deadline)
+        count = readEvents(changedNames, overflow, debounce_interval);
+
+    return (count >= 0);
+}
+
+int FileInfoWatcher::readEvents(std::set<fs::path>& changedNames, bool& overflow, unsigned int timeout)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+
+    //Events of the own log are dropped as they are read, so writing of the log
+    //neither wakes the watcher up nor prolongs the debounce
+    for (;;) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+
+        std::set<fs::path> names;
+        int count = events->read(names, overflow, static_cast<unsigned int>(std::max<long long>(0, left.count())));
+        if (count <= 0) {
+            return count;
+            //NOTREACHED
+        }
+
+        count = overflow ? 1 : 0;
+        for (auto it = names.begin(); it != names.end(); ++it) {
+            if (isOwnFile(*it))
+                continue;
+
+            changedNames.insert(*it);
+            count++;
+        }
+
+        if (count || std::chrono::steady_clock::now() >= deadline) {
+            return count;
+            //NOTREACHED
+        }
+    }
+}
+
+bool FileInfoWatcher::updateEntries(ThreadPool& pool, const std::set<fs::path>& changedNames)
+{
+    std::vector<fs::path>    paths;
+    std::vector<std::string> names;
+    std::vector<FileStat>    stats;
+
+    for (auto it = changedNames.begin(); it != changedNames.end(); ++it) {
+        fs::path cpath = work_dir / *it;
+        boost::system::error_code ec;
+
+        //Directory was created or moved in (links to directories are not followed)
+        if (is_recursive && fs::is_directory(fs::symlink_status(cpath, ec))) {
+            return false;
+            //NOTREACHED
+        }
+
+        //Deleted, renamed, replaced by a directory or filtered out
+        const std::string relPath = it->generic_string();
+        FileStat stat;
+
+        if (!fs::is_regular_file(cpath, ec) || !getFileStat(cpath, stat, ec) ||
+            !filter_spec.isPathIncluded(relPath, stat)) {
+            eraseEntries(cpath);
+            continue;
+        }
+
+        paths.push_back(cpath);
+        names.push_back(relPath);
+        stats.push_back(stat);
+    }
+
+    std::vector<std::future<FileInfo>> results;
+    for (size_t i = 0; i < paths.size(); i++) {
+        fs::path cpath = paths[i];
+        FileStat stat = stats[i];
+
+        results.push_back(pool.addTask(
+            [cpath, stat]() mutable { return FileInfoExtract(cpath, NULL, 0, NULL, NULL, NULL, &stat); }
+        ));
+    }
+
+    //Failed files are logged with the reason, the next event will refresh them
+    for (size_t i = 0; i < results.size(); i++) {
+        FileInfo finfo = results[i].get();
+
+        //Extractor knows only the file name
+        finfo.short_name = names[i];
+
+        entries[paths[i]] = finfo;
+    }
+
+    return true;
+}
+
+void FileInfoWatcher::eraseEntries(const fs::path& cpath)
+{
+    //Entries of the subtree follow the entry of its directory in the map
+    auto it = entries.lower_bound(cpath);
+    while (it != entries.end() && _t_is_within(cpath, it->first))
+        it = entries.erase(it);
+}
+
+bool FileInfoWatcher::writeLog()
+{
+    //Readers of the log never see it half written
+    {
+        std::ofstream file(tmp_log_file_path.c_str(), std::ios::out | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+            //NOTREACHED
+        }
+
+        for (auto it = entries.begin(); it != entries.end(); ++it)
+            file << it->second.toString();
+
+        file.close();
+        if (file.fail()) {
+            return false;
+            //NOTREACHED
+        }
+    }
+
+    boost::system::error_code ec;
+    fs::rename(tmp_log_file_path, log_file_path, ec);
+
+    return !ec;
+}
+
+bool FileInfoWatcher::isOwnFile(const fs::path& name) const
+{
+    return (name == log_file_path.filename() || name == tmp_log_file_path.filename());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local definitions
+//
+
+static bool _t_is_within(const fs::path& dirPath, const fs::path& filePath)
+{
+    fs::path::const_iterator fileIt = filePath.begin();
+
+    for (fs::path::const_iterator dirIt = dirPath.begin(); dirIt != dirPath.end(); ++dirIt, ++fileIt) {
+        if (fileIt == filePath.end() || *dirIt != *fileIt) {
+            return false;
+            //NOTREACHED
+        }
+    }
+
+    return true;
+}
+
+//
+//
+//
@@ -0,0 +1,173 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// FileRecord.cpp    (V. Drozd)
+// src/modules/FileInfoLogger/src/FileRecord.cpp
+//
+
+//
+// Text of the compact record, made when it is written
+//
+
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "CalculateSum/FileRecord.h"
+#include "FileInfoExtractor.h"
+
+#include <cctype>
+#include <cstring>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: definitions
+//
+
+FileRecord::FileRecord()
+    : path(NULL)
+    , root_dir(NULL)
+    , digest_type(NULL)
+    , error_reason(NULL)
+    , error_category(NULL)
+    , size(0)
+    , creation_time(0)
+    , error_code(0)
+    , is_correct(false)
+    , is_known(false)
+{
+    std::memset(digest, 0, sizeof(digest));
+}
+
+std::string FileRecord::shortName() const
+{
+    if (!path) {
+        return std::string();
+        //NOTREACHED
+    }
+
+    return root_dir ? nameOf(*root_dir, *path) : path->filename().string();
+}
+
+std::string FileRecord::checksum() const
+{
+    return formatMD5(digest);
+}
+
+std::string FileRecord::errorReason() const
+{
+    if (error_reason) {
+        return *error_reason;
+        //NOTREACHED
+    }
+
+    std::string retVal = boost::system::error_code(
+        error_code, error_category ? *error_category : boost::system::generic_category()
+    ).message();
+
+    //System messages can be finished by the line break
+    while (!retVal.empty() && std::isspace((unsigned char)retVal.back()))
+        retVal.erase(retVal.end() - 1);
+
+    return (retVal);
+}
+
+std::string FileRecord::toString() const
+{
+    std::string retVal(shortName());
+
+    if (!is_correct) {
+        retVal += ", error: " + std::to_string(error_code);
+        retVal += " (" + errorReason() + ")\n";
+        return (retVal);
+        //NOTREACHED
+    }
+
+    retVal += ", size is: " + getHumanReadableSize(static_cast<long long>(size));
+    retVal += ", created: " + formatTimeCreation(static_cast<std::time_t>(creation_time));
+    retVal += ", " + (digest_type ? *digest_type : std::string("MD5")) + ": " + checksum();
+
+    if (is_known)
+        retVal += ", KNOWN";
+
+    retVal += "\n";
+
+    return (retVal);
+}
+
+FileInfo FileRecord::toFileInfo() const
+{
+    FileInfo retVal;
+
+    retVal.full_name  = path ? path->string() : std::string();
+    retVal.short_name = shortName();
+    retVal.is_correct = is_correct;
+    retVal.is_known   = is_known;
+
+    if (!is_correct) {
+        retVal.error_code   = error_code;
+        retVal.error_reason = errorReason();
+        return (retVal);
+        //NOTREACHED
+    }
+
+    retVal.size                = static_cast<long long>(size);
+    retVal.human_readable_size = getHumanReadableSize(retVal.size);
+    retVal.creation            = formatTimeCreation(static_cast<std::time_t>(creation_time));
+    retVal.checksum            = checksum();
+
+    if (digest_type)
+        retVal.digest_type = *digest_type;
+
+    return (retVal);
+}
+
+std::string FileRecord::nameOf(const fs::path& rootDir, const fs::path& filePath)
+{
+    if (rootDir.empty()) {
+        return filePath.filename().string();
+        //NOTREACHED
+    }
+
+    fs::path::const_iterator rootIt = rootDir.begin();
+    fs::path::const_iterator fileIt = filePath.begin();
+
+    for (; rootIt != rootDir.end() && fileIt != filePath.end(); ++rootIt, ++fileIt) {
+        if (*rootIt != *fileIt)
+            break;
+    }
+
+    //Trailing separator of the root is the "." element
+    if (rootIt != rootDir.end() && *rootIt == "." && ++fs::path::const_iterator(rootIt) == rootDir.end())
+        rootIt = rootDir.end();
+
+    //File outside of the root is logged by its name
+    if (rootIt != rootDir.end() || fileIt == filePath.end()) {
+        return filePath.filename().string();
+        //NOTREACHED
+    }
+
+    //The same separator on every platform, as in the tree manifest
+    std::string retVal;
+    for (; fileIt != filePath.end(); ++fileIt) {
+        if (!retVal.empty())
+            retVal += '/';
+        retVal += fileIt->string();
+    }
+
+    return (retVal);
+}
+
+//
+//
+//
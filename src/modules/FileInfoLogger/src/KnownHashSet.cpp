@@ -0,0 +1,316 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// KnownHashSet.cpp    (V. Drozd)
+// src/modules/FileInfoLogger/src/KnownHashSet.cpp
+//
+
+//
+// Reference set of MD5 digests, memory mapped sorted table with Bloom filter
+//
+
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "CalculateSum/KnownHashSet.h"
+#include "FileInfoExtractor.h"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: variable definitions
+//
+
+static const char         _s_tableMagic[8]  = { 'C', 'S', 'U', 'M', 'K', 'H', 'S', 0 };
+static const uint32_t     _s_tableVersion   = 1;
+
+static const size_t       _s_digestSize     = 16;
+
+//About 1% of false positives, which are filtered out by the search anyway
+static const unsigned int _s_filterBitsPerDigest = 10;
+static const unsigned int _s_filterHashes        = 7;
+static const uint64_t     _s_minFilterBits       = 1024;
+
+//Filter is split into cache line blocks, every digest sets its bits in one of them,
+//so the lookup of the absent digest costs one cache miss instead of seven
+static const unsigned int _s_filterBlockBits  = 512;
+static const unsigned int _s_filterBlockShift = 9;
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local declarations
+//
+
+struct TableHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t filter_hashes;
+    uint64_t digest_count;
+    uint64_t filter_bits;
+};
+
+typedef std::array<unsigned char, _s_digestSize> Digest;
+
+//
+// Hashes of the digest for the filter, digest is already random, so its halves
+// are used as is: the first one selects the block and the second one the bits in it
+//
+
+static inline void _t_filter_hashes(const unsigned char *digest, uint64_t& h1, uint64_t& h2);
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: mapping
+//
+
+struct KnownHashSet::Mapping {
+    boost::interprocess::file_mapping  file;
+    boost::interprocess::mapped_region region;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: public function member definitions
+//
+
+KnownHashSet::KnownHashSet()
+    : filter(NULL)
+    , filter_mask(0)
+    , filter_hashes(0)
+    , digests(NULL)
+    , digest_count(0)
+{
+}
+
+KnownHashSet::~KnownHashSet()
+{
+}
+
+bool KnownHashSet::build(const fs::path& listPath, const fs::path& tablePath)
+{
+    std::ifstream list(listPath.c_str());
+    if (!list.is_open()) {
+        return false;
+        //NOTREACHED
+    }
+
+    std::vector<Digest> digestList;
+    std::string line;
+
+    while (std::getline(list, line)) {
+        //The first run of exactly 32 hex digits (SHA-1 and longer ones are skipped)
+        for (size_t pos = 0; pos < line.size(); ) {
+            if (!std::isxdigit(static_cast<unsigned char>(line[pos]))) {
+                pos++;
+                continue;
+            }
+
+            size_t last = pos;
+            while (last < line.size() && std::isxdigit(static_cast<unsigned char>(line[last])))
+                last++;
+
+            Digest digest;
+            if (last - pos == 2 * _s_digestSize && parseMD5(line.c_str() + pos, digest.data())) {
+                digestList.push_back(digest);
+                break;
+            }
+
+            pos = last;
+        }
+    }
+
+    std::sort(digestList.begin(), digestList.end());
+    digestList.erase(std::unique(digestList.begin(), digestList.end()), digestList.end());
+
+    TableHeader header;
+    std::memcpy(header.magic, _s_tableMagic, sizeof(header.magic));
+    header.version = _s_tableVersion;
+    header.filter_hashes = _s_filterHashes;
+    header.digest_count = digestList.size();
+
+    //Power of two, so the bit position is taken by mask
+    header.filter_bits = _s_minFilterBits;
+    while (header.filter_bits < header.digest_count * _s_filterBitsPerDigest)
+        header.filter_bits <<= 1;
+
+    std::vector<unsigned char> filterBits(static_cast<size_t>(header.filter_bits / 8));
+    const uint64_t blockMask = header.filter_bits / _s_filterBlockBits - 1;
+
+    for (size_t i = 0; i < digestList.size(); i++) {
+        uint64_t h1, h2;
+        _t_filter_hashes(digestList[i].data(), h1, h2);
+
+        unsigned char *block = &filterBits[static_cast<size_t>((h1 & blockMask) * (_s_filterBlockBits / 8))];
+
+        for (unsigned int k = 0; k < header.filter_hashes; k++) {
+            unsigned int bit = static_cast<unsigned int>(h2 >> (k * _s_filterBlockShift)) & (_s_filterBlockBits - 1);
+            block[bit >> 3] |= static_cast<unsigned char>(1 << (bit & 7));
+        }
+    }
+
+    std::ofstream table(tablePath.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!table.is_open()) {
+        return false;
+        //NOTREACHED
+    }
+
+    table.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    table.write(reinterpret_cast<const char *>(filterBits.data()), filterBits.size());
+    if (!digestList.empty())
+        table.write(reinterpret_cast<const char *>(digestList.data()), digestList.size() * _s_digestSize);
+
+    table.close();
+    return !table.fail();
+}
+
+bool KnownHashSet::open(const fs::path& tablePath)
+{
+    namespace ipc = boost::interprocess;
+
+    mapping.reset();
+    filter = digests = NULL;
+    filter_mask = digest_count = 0;
+    filter_hashes = 0;
+
+    std::unique_ptr<Mapping> newMapping(new Mapping);
+
+    //Interprocess library reports errors only by exceptions
+    try {
+        ipc::file_mapping file(tablePath.string().c_str(), ipc::read_only);
+        ipc::mapped_region region(file, ipc::read_only);
+
+        newMapping->file.swap(file);
+        newMapping->region.swap(region);
+    }
+    catch (const ipc::interprocess_exception&) {
+        return false;
+        //NOTREACHED
+    }
+
+    const unsigned char *data = static_cast<const unsigned char *>(newMapping->region.get_address());
+    const uint64_t dataSize = newMapping->region.get_size();
+
+    TableHeader header;
+    if (dataSize < sizeof(header)) {
+        return false;
+        //NOTREACHED
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    if (std::memcmp(header.magic, _s_tableMagic, sizeof(header.magic)) ||
+        header.version != _s_tableVersion ||
+        !header.filter_hashes || header.filter_hashes * _s_filterBlockShift > 64 ||
+        header.filter_bits < _s_filterBlockBits || (header.filter_bits & (header.filter_bits - 1))) {
+        return false;
+        //NOTREACHED
+    }
+
+    //Truncated or damaged table
+    if (dataSize != sizeof(header) + header.filter_bits / 8 + header.digest_count * _s_digestSize) {
+        return false;
+        //NOTREACHED
+    }
+
+    filter = data + sizeof(header);
+    filter_mask = header.filter_bits / _s_filterBlockBits - 1;
+    filter_hashes = header.filter_hashes;
+
+    digests = filter + header.filter_bits / 8;
+    digest_count = header.digest_count;
+
+    mapping.swap(newMapping);
+
+    return true;
+}
+
+unsigned long long KnownHashSet::size() const
+{
+    return digest_count;
+}
+
+bool KnownHashSet::contains(const std::string& checksum) const
+{
+    unsigned char digest[_s_digestSize];
+
+    if (checksum.size() != 2 * _s_digestSize || !parseMD5(checksum.c_str(), digest)) {
+        return false;
+        //NOTREACHED
+    }
+
+    return contains(digest);
+}
+
+bool KnownHashSet::contains(const unsigned char digest[16]) const
+{
+    if (!digest_count) {
+        return false;
+        //NOTREACHED
+    }
+
+    uint64_t h1, h2;
+    _t_filter_hashes(digest, h1, h2);
+
+    //All bits of the digest are in one cache line
+    const unsigned char *block = filter + (h1 & filter_mask) * (_s_filterBlockBits / 8);
+
+    for (unsigned int k = 0; k < filter_hashes; k++) {
+        unsigned int bit = static_cast<unsigned int>(h2 >> (k * _s_filterBlockShift)) & (_s_filterBlockBits - 1);
+        if (!(block[bit >> 3] & (1 << (bit & 7)))) {
+            return false;
+            //NOTREACHED
+        }
+    }
+
+    //Probably in the set, so search the table
+    unsigned long long first = 0;
+    unsigned long long last = digest_count;
+
+    while (first < last) {
+        unsigned long long middle = first + (last - first) / 2;
+        int rc = std::memcmp(digests + middle * _s_digestSize, digest, _s_digestSize);
+
+        if (!rc) {
+            return true;
+            //NOTREACHED
+        }
+
+        if (rc < 0)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local definitions
+//
+
+static inline void _t_filter_hashes(const unsigned char *digest, uint64_t& h1, uint64_t& h2)
+{
+    std::memcpy(&h1, digest, sizeof(h1));
+    std::memcpy(&h2, digest + sizeof(h1), sizeof(h2));
+}
+
+//
+//
+//
@@ -0,0 +1,127 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// LogReader.cpp    (V. Drozd)
+// src/modules/FileInfoLogger/src/LogReader.cpp
+//
+
+//
+// Reads the plain or gzip compressed log line by line
+//
+
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "LogReader.h"
+
+#include <cstring>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: variable definitions
+//
+
+//Size of the zlib input buffer, logs are read sequentially
+static const unsigned int _s_readBufferSize = 256 * 1024;
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: public function member definitions
+//
+
+LogReader::LogReader()
+    : file(NULL)
+{
+}
+
+LogReader::~LogReader()
+{
+    close();
+}
+
+bool LogReader::open(const fs::path& logPath)
+{
+    close();
+
+    //Without the gzip header the file is read transparently
+#ifdef _WIN32
+    file = gzopen_w(logPath.c_str(), "rb");
+#else
+    file = gzopen(logPath.c_str(), "rb");
+#endif
+    if (!file) {
+        return false;
+        //NOTREACHED
+    }
+
+    gzbuffer(file, _s_readBufferSize);
+    return true;
+}
+
+bool LogReader::is_open() const
+{
+    return (file != NULL);
+}
+
+void LogReader::close()
+{
+    if (file) {
+        gzclose(file);
+        file = NULL;
+    }
+}
+
+bool LogReader::getline(std::string& line)
+{
+    line.clear();
+
+    if (!file) {
+        return false;
+        //NOTREACHED
+    }
+
+    char chunk[4096];
+
+    //Long line is read by several chunks
+    while (gzgets(file, chunk, sizeof(chunk))) {
+        size_t len = std::strlen(chunk);
+
+        if (len && '\n' == chunk[len - 1]) {
+            line.append(chunk, len - 1);
+            return true;
+            //NOTREACHED
+        }
+
+        line.append(chunk, len);
+    }
+
+    //The last line may have no '\n', the broken stream is not the end
+    return (!line.empty() && !is_broken());
+}
+
+bool LogReader::is_broken() const
+{
+    if (!file) {
+        return false;
+        //NOTREACHED
+    }
+
+    int err = Z_OK;
+    gzerror(file, &err);
+
+    return (Z_OK != err && Z_STREAM_END != err);
+}
+
+//
+//
+//
@@ -0,0 +1,63 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// LogReader.h (V. Drozd)
+// src/modules/FileInfoLogger/src/LogReader.h
+//
+
+//
+// Reads the log line by line, the gzip compressed log is decompressed
+// on the fly, the plain one is read as is
+//
+
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+// EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+#include "CalculateSum/Types.h"
+
+#include <string>
+
+#include <zlib.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declarations
+//
+
+class LogReader {
+public:
+    LogReader();
+    ~LogReader();
+
+    bool open(const fs::path& logPath);
+    bool is_open() const;
+    void close();
+
+    //Next line without '\n', false at the end of the log or if it is corrupted
+    bool getline(std::string& line);
+
+    //Compressed stream is corrupted or truncated
+    bool is_broken() const;
+private:
+    //deprecate copy constructor and assigment operator
+    LogReader(const LogReader&);
+    LogReader& operator=(const LogReader&);
+
+
+    gzFile file;
+};
+
+//
+//
+//
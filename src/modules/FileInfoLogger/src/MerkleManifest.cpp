@@ -0,0 +1,422 @@
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// MerkleManifest.cpp    (V. Drozd)
+// src/modules/FileInfoLogger/src/MerkleManifest.cpp
+//
+
+//
+// Manifest of the whole directory tree with digests of the directories
+//
+
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+//  EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+//  WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "CalculateSum/MerkleManifest.h"
+#include "FileInfoExtractor.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: variable definitions
+//
+
+static const char _s_rootPath[] = ".";
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local declarations
+//
+
+//
+// One line of the manifest, end is the position after its subtree
+//
+
+struct ManifestEntry {
+    char        type;
+    std::string digest;
+    long long   number;
+    std::string path;
+    long long   end;
+};
+
+//
+// Read the next entry, the stream is failed if the line is malformed
+//
+
+static bool _t_read_entry(std::istream& in, ManifestEntry& entry);
+
+//
+// Read the next child of the directory which subtree is finished at end
+//
+
+static bool _t_next_child(std::istream& in, long long end, ManifestEntry& entry);
+
+//
+// Move the stream after the subtree of the entry
+//
+
+static void _t_skip_entry(std::istream& in, const ManifestEntry& entry);
+
+static void _t_report(std::ostream& report, const char *kind, const ManifestEntry& entry, size_t& differences);
+
+//
+// Merge children of two directories with different digests
+//
+
+static void _t_compare_children(std::istream& oldIn, long long oldEnd,
+                                std::istream& newIn, long long newEnd,
+                                std::ostream& report, size_t& differences);
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: public function member definitions
+//
+
+MerkleManifest::MerkleManifest(const fs::path& rootDir)
+    : root_dir(rootDir)
+    , failed_count(0)
+{
+}
+
+bool MerkleManifest::process()
+{
+    nodes.clear();
+    results.clear();
+    failed_count = 0;
+
+    boost::system::error_code ec;
+    if (!fs::is_directory(root_dir, ec)) {
+        return false;
+        //NOTREACHED
+    }
+
+    Node root;
+    root.type = 'D';
+    root.path = _s_rootPath;
+    root.number = 0;
+    root.first_child = root.child_count = 0;
+
+    nodes.push_back(root);
+    results.resize(1);
+
+    {
+        //Create thread pool with optimal size for logger
+        ThreadPool pool(std::max(1U, std::thread::hardware_concurrency() - 1));
+
+        //Files are hashed while the rest of the tree is scanned
+        scanDir(pool, 0);
+
+        finalize();
+    }
+
+    results.clear();
+
+    return true;
+}
+
+bool MerkleManifest::write(const fs::path& manifestPath) const
+{
+    if (nodes.empty()) {
+        return false;
+        //NOTREACHED
+    }
+
+    //Binary, so the subtree lengths are the same on every platform
+    std::ofstream file(manifestPath.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+        //NOTREACHED
+    }
+
+    writeNode(file, 0);
+
+    file.close();
+    return !file.fail();
+}
+
+std::string MerkleManifest::rootDigest() const
+{
+    return nodes.empty() ? std::string() : nodes[0].digest;
+}
+
+size_t MerkleManifest::failedCount() const
+{
+    return failed_count;
+}
+
+bool MerkleManifest::compare(const fs::path& oldManifest, const fs::path& newManifest,
+                             std::ostream& report, size_t& differences)
+{
+    differences = 0;
+
+    std::ifstream oldIn(oldManifest.c_str(), std::ios::in | std::ios::binary);
+    std::ifstream newIn(newManifest.c_str(), std::ios::in | std::ios::binary);
+
+    if (!oldIn.is_open() || !newIn.is_open()) {
+        return false;
+        //NOTREACHED
+    }
+
+    ManifestEntry oldRoot, newRoot;
+    if (!_t_read_entry(oldIn, oldRoot) || !_t_read_entry(newIn, newRoot) ||
+        oldRoot.type != 'D' || newRoot.type != 'D') {
+        return false;
+        //NOTREACHED
+    }
+
+    //The same trees are recognized by the first line
+    if (oldRoot.digest != newRoot.digest)
+        _t_compare_children(oldIn, oldRoot.end, newIn, newRoot.end, report, differences);
+
+    return (!oldIn.fail() && !newIn.fail());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: private function member definitions
+//
+
+void MerkleManifest::scanDir(ThreadPool& pool, const size_t dirIdx)
+{
+    const std::string dirPath = nodes[dirIdx].path;
+    const fs::path fullDirPath = (dirPath == _s_rootPath) ? root_dir : root_dir / dirPath;
+
+    std::vector<std::pair<std::string, char>> children;
+    boost::system::error_code ec;
+
+    fs::directory_iterator it(fullDirPath, ec);
+    fs::directory_iterator endit;
+
+    for (; !ec && it != endit; it.increment(ec)) {
+        fs::file_status status = it->symlink_status(ec);
+        if (ec)
+            break;
+
+        if (fs::is_regular_file(status))
+            children.push_back(std::make_pair(it->path().filename().string(), 'F'));
+        else if (fs::is_directory(status))
+            children.push_back(std::make_pair(it->path().filename().string(), 'D'));
+    }
+
+    //Unreadable directory doesn't match anything
+    if (ec) {
+        nodes[dirIdx].type = 'E';
+        nodes[dirIdx].digest = std::to_string(ec.value());
+        return;
+        //NOTREACHED
+    }
+
+    std::sort(children.begin(), children.end());
+
+    const size_t firstChild = nodes.size();
+    nodes[dirIdx].first_child = firstChild;
+    nodes[dirIdx].child_count = children.size();
+
+    for (size_t i = 0; i < children.size(); i++) {
+        Node child;
+        child.type = children[i].second;
+        child.path = (dirPath == _s_rootPath) ? children[i].first : dirPath + "/" + children[i].first;
+        child.number = 0;
+        child.first_child = child.child_count = 0;
+
+        nodes.push_back(child);
+    }
+    results.resize(nodes.size());
+
+    for (size_t i = firstChild; i < nodes.size(); i++) {
+        if (nodes[i].type != 'F')
+            continue;
+
+        fs::path fpath = root_dir / nodes[i].path;
+        results[i] = pool.addTask([fpath]() mutable { return FileInfoExtract(fpath); });
+    }
+
+    //Subdirectories are appended after all children of this one
+    for (size_t i = firstChild; i < firstChild + children.size(); i++) {
+        if (nodes[i].type == 'D')
+            scanDir(pool, i);
+    }
+}
+
+void MerkleManifest::finalize()
+{
+    //Children are always after their parent, so they are ready first
+    for (size_t i = nodes.size(); i-- > 0; ) {
+        Node& node = nodes[i];
+
+        if (node.type == 'E') {
+            failed_count++;
+            continue;
+        }
+
+        if (node.type == 'F') {
+            FileInfo finfo = results[i].get();
+
+            if (finfo.is_correct) {
+                node.digest = finfo.checksum;
+                node.number = finfo.size;
+            }
+            else {
+                node.type = 'E';
+                node.digest = std::to_string(finfo.error_code);
+                failed_count++;
+            }
+            continue;
+        }
+
+        std::string children;
+        node.number = 0;
+
+        for (size_t j = node.first_child; j < node.first_child + node.child_count; j++) {
+            const Node& child = nodes[j];
+            const std::string name = child.path.substr(child.path.rfind('/') + 1);
+
+            children += child.type;
+            children += " " + child.digest + " " + name + "\n";
+
+            node.number += nodeLine(child).size();
+            if (child.type == 'D')
+                node.number += child.number;
+        }
+
+        node.digest = getDataMD5(children.data(), children.size());
+    }
+}
+
+void MerkleManifest::writeNode(std::ostream& out, const size_t idx) const
+{
+    const Node& node = nodes[idx];
+
+    out << nodeLine(node);
+
+    for (size_t i = node.first_child; i < node.first_child + node.child_count; i++)
+        writeNode(out, i);
+}
+
+std::string MerkleManifest::nodeLine(const Node& node)
+{
+    std::string retVal(1, node.type);
+
+    retVal += " " + node.digest;
+    retVal += " " + std::to_string(node.number);
+    retVal += " " + node.path + "\n";
+
+    return (retVal);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: local definitions
+//
+
+static bool _t_read_entry(std::istream& in, ManifestEntry& entry)
+{
+    std::string line;
+    if (!std::getline(in, line)) {
+        return false;
+        //NOTREACHED
+    }
+
+    auto digestEnd = line.find(' ', 2);
+    auto numberEnd = (digestEnd == std::string::npos) ? digestEnd : line.find(' ', digestEnd + 1);
+
+    if (line.size() < 2 || line[1] != ' ' || numberEnd == std::string::npos) {
+        in.setstate(std::ios::failbit);
+        return false;
+        //NOTREACHED
+    }
+
+    entry.type   = line[0];
+    entry.digest = line.substr(2, digestEnd - 2);
+    entry.number = std::atoll(line.c_str() + digestEnd + 1);
+    entry.path   = line.substr(numberEnd + 1);
+    entry.end    = static_cast<long long>(in.tellg()) + ((entry.type == 'D') ? entry.number : 0);
+
+    return true;
+}
+
+static bool _t_next_child(std::istream& in, long long end, ManifestEntry& entry)
+{
+    if (!in || static_cast<long long>(in.tellg()) >= end) {
+        return false;
+        //NOTREACHED
+    }
+
+    return _t_read_entry(in, entry);
+}
+
+static void _t_skip_entry(std::istream& in, const ManifestEntry& entry)
+{
+    if (entry.type == 'D')
+        in.seekg(entry.end);
+}
+
+static void _t_report(std::ostream& report, const char *kind, const ManifestEntry& entry, size_t& differences)
+{
+    report << kind << " " << entry.path << ((entry.type == 'D') ? "/" : "") << "\n";
+    differences++;
+}
+
+static void _t_compare_children(std::istream& oldIn, long long oldEnd,
+                                std::istream& newIn, long long newEnd,
+                                std::ostream& report, size_t& differences)
+{
+    ManifestEntry oldEntry, newEntry;
+
+    bool hasOld = _t_next_child(oldIn, oldEnd, oldEntry);
+    bool hasNew = _t_next_child(newIn, newEnd, newEntry);
+
+    while (hasOld || hasNew) {
+        //Children of both directories are sorted by name and have the same parent
+        int rc = !hasOld ? 1 : (!hasNew ? -1 : oldEntry.path.compare(newEntry.path));
+
+        if (rc < 0) {
+            _t_report(report, "REMOVED", oldEntry, differences);
+            _t_skip_entry(oldIn, oldEntry);
+        }
+        else if (rc > 0) {
+            _t_report(report, "ADDED", newEntry, differences);
+            _t_skip_entry(newIn, newEntry);
+        }
+        else if (oldEntry.type != newEntry.type && (oldEntry.type == 'D' || newEntry.type == 'D')) {
+            //File became directory or vice versa
+            _t_report(report, "REMOVED", oldEntry, differences);
+            _t_report(report, "ADDED", newEntry, differences);
+            _t_skip_entry(oldIn, oldEntry);
+            _t_skip_entry(newIn, newEntry);
+        }
+        else if (oldEntry.type == 'E' || newEntry.type == 'E' || oldEntry.digest != newEntry.digest) {
+            if (oldEntry.type == 'D')
+                _t_compare_children(oldIn, oldEntry.end, newIn, newEntry.end, report, differences);
+            else
+                _t_report(report, "MODIFIED", newEntry, differences);
+        }
+        else {
+            //The same subtree, it is not read at all
+            _t_skip_entry(oldIn, oldEntry);
+            _t_skip_entry(newIn, newEntry);
+        }
+
+        if (rc <= 0)
+            hasOld = _t_next_child(oldIn, oldEnd, oldEntry);
+        if (rc >= 0)
+            hasNew = _t_next_child(newIn, newEnd, newEntry);
+    }
+}
+
+//
+//
+//
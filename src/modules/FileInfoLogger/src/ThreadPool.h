@@ -1,196 +1,261 @@
-//
-// -*- Mode: c++; tab-width: 4; -*-
-// -*- ex: ts=4 -*-
-//
-
-//
-// ThreadPool.h (Jakob Progsch, edited by Vadym Drozd)
-// src/FileInfoLogger/ThreadPool.h
-//
-
-//
-// A Thread Pool with C++11
-//
-
-//
-//  Copyright(c) 2012 Jakob Progsch
-//
-//  This software is provided 'as-is', without any express or implied
-//  warranty.In no event will the authors be held liable for any damages
-//  arising from the use of this software.
-//
-//  Permission is granted to anyone to use this software for any purpose,
-//  including commercial applications, and to alter it and redistribute it
-//  freely, subject to the following restrictions :
-//
-//  1. The origin of this software must not be misrepresented; you must not
-//  claim that you wrote the original software.If you use this software
-//  in a product, an acknowledgment in the product documentation would be
-//  appreciated but is not required.
-//
-//  2. Altered source versions must be plainly marked as such, and must not be
-//  misrepresented as being the original software.
-//
-//  3. This notice may not be removed or altered from any source
-//  distribution.
-//
-
-///////////////////////////////////////////////////////////////////////////////
-// %% BeginSection: includes
-//
-
-#pragma once
-
-
-#include <vector>
-#include <list>
-#include <memory>
-#include <thread>
-#include <mutex>
-#include <condition_variable>
-#include <future>
-#include <functional>
-#include <stdexcept>
-
-///////////////////////////////////////////////////////////////////////////////
-// %% BeginSection: declaration
-//
-
-typedef std::function<void()> fn_type;
-
-class ThreadPool {
-public:
-    ThreadPool(size_t = std::thread::hardware_concurrency());
-    ~ThreadPool();
-
-    template<class F, class... Args>
-    auto addTask(F&& f, Args&&... args)
-        -> std::future<typename std::result_of<F(Args...)>::type>;
-
-    // wait for the completion of all tasks
-    // (meaning that all worker are waiting for new tasks)
-    void wait() const;
-
-    void clearTaskQueue();
-
-private:
-    // need to keep track of threads so we can join them
-    std::vector<std::thread> workers;
-    
-    // the task queue
-    std::list<fn_type> tasks;
-
-    // synchronization
-    std::mutex queue_mutex;
-    std::condition_variable condition;
-    bool stop;
-
-    // waiting for completion
-    size_t active_worker;
-    mutable std::mutex work_done_mutex;
-    mutable std::condition_variable work_done_condition;
-
-    void thread_fn();
-};
-
-///////////////////////////////////////////////////////////////////////////////
-// %% BeginSection: definition
-//
-
-// the constructor just launches some amount of workers
-inline ThreadPool::ThreadPool(size_t threads)
-    : stop(false)
-    , active_worker(threads)
-{
-    for (size_t i = 0; i < threads; ++i) {
-        workers.emplace_back(&ThreadPool::thread_fn, this);
-    }
-}
-
-inline void ThreadPool::thread_fn()
-{
-    for (;;) {
-        std::unique_lock<std::mutex> lock(queue_mutex);
-
-        --active_worker;
-        
-        while (!stop && tasks.empty()) {
-            work_done_condition.notify_one(); // signal that this thread is done
-            condition.wait(lock);             // and wait for more tasks
-        }
-
-        if (stop && tasks.empty())
-            return;
-
-        ++active_worker;
-
-        //Get task from queue
-        fn_type task(tasks.front());
-        tasks.pop_front();
-        lock.unlock();
-
-        //And do it
-        task();
-    }
-}
-
-// add new work item to the pool
-template<class F, class... Args>
-auto ThreadPool::addTask(F&& f, Args&&... args)
-    -> std::future<typename std::result_of<F(Args...)>::type>
-{
-    using return_type = typename std::result_of<F(Args...)>::type;
-    using packaged_task_type = typename std::packaged_task<return_type()>;
-
-    // don't allow addTask after stopping the pool
-    if (stop) {
-        throw std::runtime_error("enqueue on stopped ThreadPool");
-        //NOTREACHED
-    }
-
-    //Prepare and add task to queue
-    auto binded_fn = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
-    auto task = std::make_shared<packaged_task_type>(binded_fn);
-    std::future<return_type> res = task->get_future();
-
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex);
-        tasks.emplace_back([task](){ (*task)(); });
-    }
-
-    //Notify that there is new task in queue
-    condition.notify_one();
-    return res;
-}
-
-inline void ThreadPool::wait() const
-{
-    std::unique_lock<std::mutex> lock(work_done_mutex);
-
-    // wait until all threads are done and tasks are empty
-    while (!(active_worker == 0 && tasks.empty()))
-        work_done_condition.wait(lock);
-}
-
-inline void ThreadPool::clearTaskQueue() 
-{
-    std::unique_lock<std::mutex> lock(this->queue_mutex);
-    tasks.clear();
-}
-    
-// the destructor joins all threads
-inline ThreadPool::~ThreadPool()
-{
-    {
-        std::unique_lock<std::mutex> lock(this->queue_mutex);
-        stop = true;
-    }
-
-    condition.notify_all();
-    for (size_t i = 0; i < workers.size(); ++i)
-        workers[i].join();
-}
-
-//
-//
-//
+//
+// -*- Mode: c++; tab-width: 4; -*-
+// -*- ex: ts=4 -*-
+//
+
+//
+// ThreadPool.h (Jakob Progsch, edited by Vadym Drozd)
+// src/FileInfoLogger/ThreadPool.h
+//
+
+//
+// A Thread Pool with C++11
+//
+
+//
+//  Copyright(c) 2012 Jakob Progsch
+//
+//  This software is provided 'as-is', without any express or implied
+//  warranty.In no event will the authors be held liable for any damages
+//  arising from the use of this software.
+//
+//  Permission is granted to anyone to use this software for any purpose,
+//  including commercial applications, and to alter it and redistribute it
+//  freely, subject to the following restrictions :
+//
+//  1. The origin of this software must not be misrepresented; you must not
+//  claim that you wrote the original software.If you use this software
+//  in a product, an acknowledgment in the product documentation would be
+//  appreciated but is not required.
+//
+//  2. Altered source versions must be plainly marked as such, and must not be
+//  misrepresented as being the original software.
+//
+//  3. This notice may not be removed or altered from any source
+//  distribution.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: includes
+//
+
+#pragma once
+
+
+#include <vector>
+#include <list>
+#include <set>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <stdexcept>
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: declaration
+//
+
+typedef std::function<void()> fn_type;
+
+class ThreadPool {
+public:
+    ThreadPool(size_t = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    template<class F, class... Args>
+    auto addTask(F&& f, Args&&... args)
+        -> std::future<typename std::result_of<F(Args...)>::type>;
+
+    // wait for the completion of all tasks
+    // (meaning that all worker are waiting for new tasks)
+    void wait() const;
+
+    void clearTaskQueue();
+
+    // start one more worker
+    void addWorker();
+
+    // start one more worker instead of the one that hangs in a task (given by
+    // the id of its thread); the hung worker exits when the task returns, and
+    // the pool doesn't wait for it when it is destroyed, so the task must not
+    // touch anything that dies with its owner after it is abandoned
+    void abandonWorker(std::thread::id worker);
+
+private:
+    // everything the workers touch, so the abandoned one may outlive the pool
+    struct State {
+        // the task queue
+        std::list<fn_type> tasks;
+
+        // synchronization
+        std::mutex queue_mutex;
+        std::condition_variable condition;
+        bool stop;
+
+        // waiting for completion
+        size_t active_worker;
+        std::mutex work_done_mutex;
+        std::condition_variable work_done_condition;
+
+        // workers that hang in their tasks, they are not joined
+        std::set<std::thread::id> abandoned;
+
+        State(size_t threads)
+            : stop(false)
+            , active_worker(threads)
+        {
+        }
+    };
+
+    // need to keep track of threads so we can join them
+    std::vector<std::thread> workers;
+
+    std::shared_ptr<State> state;
+
+    static void thread_fn(std::shared_ptr<State> state);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// %% BeginSection: definition
+//
+
+// the constructor just launches some amount of workers
+inline ThreadPool::ThreadPool(size_t threads)
+    : state(std::make_shared<State>(threads))
+{
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back(&ThreadPool::thread_fn, state);
+    }
+}
+
+inline void ThreadPool::thread_fn(std::shared_ptr<State> state)
+{
+    for (;;) {
+        std::unique_lock<std::mutex> lock(state->queue_mutex);
+
+        --state->active_worker;
+        
+        while (!state->stop && state->tasks.empty()) {
+            state->work_done_condition.notify_one(); // signal that this thread is done
+            state->condition.wait(lock);             // and wait for more tasks
+        }
+
+        if (state->stop && state->tasks.empty())
+            return;
+
+        ++state->active_worker;
+
+        //Get task from queue
+        fn_type task(state->tasks.front());
+        state->tasks.pop_front();
+        lock.unlock();
+
+        //And do it
+        task();
+
+        //Abandoned worker isn't counted as active already, and it isn't reused
+        lock.lock();
+        if (state->abandoned.count(std::this_thread::get_id())) {
+            return;
+            //NOTREACHED
+        }
+        lock.unlock();
+    }
+}
+
+// add new work item to the pool
+template<class F, class... Args>
+auto ThreadPool::addTask(F&& f, Args&&... args)
+    -> std::future<typename std::result_of<F(Args...)>::type>
+{
+    using return_type = typename std::result_of<F(Args...)>::type;
+    using packaged_task_type = typename std::packaged_task<return_type()>;
+
+    // don't allow addTask after stopping the pool
+    if (state->stop) {
+        throw std::runtime_error("enqueue on stopped ThreadPool");
+        //NOTREACHED
+    }
+
+    //Prepare and add task to queue
+    auto binded_fn = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
+    auto task = std::make_shared<packaged_task_type>(binded_fn);
+    std::future<return_type> res = task->get_future();
+
+    {
+        std::unique_lock<std::mutex> lock(state->queue_mutex);
+        state->tasks.emplace_back([task](){ (*task)(); });
+    }
+
+    //Notify that there is new task in queue
+    state->condition.notify_one();
+    return res;
+}
+
+inline void ThreadPool::wait() const
+{
+    std::unique_lock<std::mutex> lock(state->work_done_mutex);
+
+    // wait until all threads are done and tasks are empty
+    while (!(state->active_worker == 0 && state->tasks.empty()))
+        state->work_done_condition.wait(lock);
+}
+
+inline void ThreadPool::clearTaskQueue() 
+{
+    std::unique_lock<std::mutex> lock(state->queue_mutex);
+    state->tasks.clear();
+}
+
+inline void ThreadPool::addWorker()
+{
+    std::unique_lock<std::mutex> lock(state->queue_mutex);
+
+    // the new worker decrements it when it starts waiting for a task
+    ++state->active_worker;
+    workers.emplace_back(&ThreadPool::thread_fn, state);
+}
+
+inline void ThreadPool::abandonWorker(std::thread::id worker)
+{
+    {
+        std::unique_lock<std::mutex> lock(state->queue_mutex);
+
+        // it doesn't take the tasks anymore, so it isn't active
+        state->abandoned.insert(worker);
+        --state->active_worker;
+    }
+
+    addWorker();
+}
+    
+// the destructor joins all threads, except the abandoned ones
+inline ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(state->queue_mutex);
+        state->stop = true;
+    }
+
+    state->condition.notify_all();
+
+    // the abandoned workers may never return, they are left with the state
+    std::set<std::thread::id> abandoned;
+    {
+        std::unique_lock<std::mutex> lock(state->queue_mutex);
+        abandoned = state->abandoned;
+    }
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+        if (abandoned.count(workers[i].get_id()))
+            workers[i].detach();
+        else
+            workers[i].join();
+    }
+}
+
+//
+//
+//